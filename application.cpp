@@ -10,12 +10,29 @@
 #include <time.h>
 #include <string>
 #include <iostream>
+#include <atomic>
+#include <thread>
 
 //------------------------------------------------------------------------------
 #include "chai3d.h"
 //------------------------------------------------------------------------------
 #include <GLFW/glfw3.h>
 //------------------------------------------------------------------------------
+#include "motion.h"
+#include "game.h"
+#include "batch.h"
+#include "realtime.h"
+#include "bvh.h"
+#include "sdf.h"
+#include "pose_predictor.h"
+#include "quality.h"
+#include "point_shell.h"
+#include "lod.h"
+#include "passivity.h"
+#include "frame_pipeline.h"
+#include "device_sample.h"
+#include "trace.h"
+//------------------------------------------------------------------------------
 using namespace chai3d;
 using namespace std;
 //------------------------------------------------------------------------------
@@ -39,6 +56,56 @@ bool fullscreen = false;
 // mirrored display
 bool mirroredDisplay = false;
 
+// haptic contact backend for the static game board
+/*
+	BOARD_COLLISION_AABB:      CHAI3D AABB tree queried by the tool proxy
+	BOARD_COLLISION_FLAT_BVH:  Flat BVH queried with the tool sphere (--board=bvh)
+	BOARD_COLLISION_SDF:       Signed distance field baked at load time (--board=sdf)
+*/
+enum BoardCollision
+{
+	BOARD_COLLISION_AABB,
+	BOARD_COLLISION_FLAT_BVH,
+	BOARD_COLLISION_SDF
+};
+BoardCollision boardCollision = BOARD_COLLISION_AABB;
+
+// haptic shape of the hammer
+/*
+	HAMMER_CONTACT_SPHERE:  One tool sphere touching the scene through CHAI3D
+	HAMMER_CONTACT_POINTS:  Head sampled as contact points queried in batches (--hammer=points)
+*/
+enum HammerContact
+{
+	HAMMER_CONTACT_SPHERE,
+	HAMMER_CONTACT_POINTS
+};
+HammerContact hammerContact = HAMMER_CONTACT_SPHERE;
+
+// real-time mode for the haptic thread (Linux only), enabled with --realtime[=core]
+bool realtimeMode = false;
+
+// isolated core the haptic thread is pinned to in real-time mode
+int realtimeCore = 3;
+
+// quality levels the haptic thread steps through when its ticks overrun
+/*
+	QUALITY_FULL:               Everything enabled
+	QUALITY_NO_FRICTION_AUDIO:  Friction sounds muted
+	QUALITY_REDUCED_LOGIC:      Hamster behaviours and motions updated every 4th tick
+	QUALITY_COARSE_COLLISION:   Board touched through its distance field, skipped without one
+	QUALITY_NO_VIBRATION:       Hit vibration effect disabled
+*/
+enum QualityLevel
+{
+	QUALITY_FULL,
+	QUALITY_NO_FRICTION_AUDIO,
+	QUALITY_REDUCED_LOGIC,
+	QUALITY_COARSE_COLLISION,
+	QUALITY_NO_VIBRATION,
+	QUALITY_LEVELS
+};
+
 //------------------------------------------------------------------------------
 // DECLARED VARIABLES
 //------------------------------------------------------------------------------
@@ -69,20 +136,64 @@ cAudioBuffer* audioHamsterHit;
 
 cAudioSource* audioSourceHit;
 
-/*
-  0 = bottom
-  1 = upwards
-  2 = top
-  3 = downwards
-  4 = unconcious
- */
-vector<vector<int>> hamsterState(3, vector<int>(3));
-// objects
-vector<vector<cMultiMesh *>> hamsters;
+// friction sound gains of the board and hamster materials
+const double groundFrictionGain = 0.4;
+const double hamsterFrictionGain = 0.8;
+
+// flags hamsters above their rest under the board, the others are left out
+// of collision and rendering
+vector<vector<bool>> hamsterActive(3, vector<bool>(3, true));
+// objects, created once and reused by every round
+vector<vector<cMultiMesh *>> hamsters(3, vector<cMultiMesh *>(3, NULL));
+// copies of the hamsters that are drawn, placed by the graphics thread at
+// their predicted pose while the originals stay hidden for haptic contact
+vector<vector<cMultiMesh *>> hamsterVisuals(3, vector<cMultiMesh *>(3, NULL));
 
 cMultiMesh *hammer;
 cMultiMesh *game_world;
 
+// objects that are only drawn: the hammer, the hamster copies and all levels
+// of detail. The haptic thread never walks this branch of the world.
+cGenericObject *renderRoot;
+
+// simplified levels drawn in place of the meshes when they are small on
+// screen, the board is cut into tiles so its far side simplifies on its own
+LodGroup boardLod;
+LodGroup hammerLod;
+vector<vector<LodGroup>> hamsterLods(3, vector<LodGroup>(3));
+
+// largest error of a drawn level of detail [pixels]
+const double lodMaxPixels = 1.0;
+
+// flat collision tree of the board in its local frame
+FlatBVH boardBVH;
+
+// distance field of the board in its local frame, cached next to the mesh
+DistanceField boardSDF;
+const float boardSDFCell = 0.05f;
+
+// contact stiffness of the board [N/m]
+double boardStiffness;
+
+// contact stiffness of the hamsters [N/m]
+const double hamsterStiffness = 10.0;
+
+// flat collision tree of the hamster mesh shared by all hamsters
+FlatBVH hamsterBVH;
+
+// contact points on the hammer head, the head lies within reach of the
+// device point and is sampled every spacing
+PointShell hammerShell(0.03f);
+const float hammerShellSpacing = 0.05f;
+const double hammerHeadReach = 0.3;
+// depth behind a surface down to which a point still pushes back, a fast
+// strike moves the head about a centimeter per tick
+const float hammerShellDepth = 0.06f;
+
+// contact points moved into the frame of a target, and their hits
+vector<float> hammerShellLocal;
+vector<BVHHit> hammerShellHits;
+
 // a haptic device handler
 cHapticDeviceHandler *handler;
 
@@ -118,6 +229,58 @@ cFrequencyCounter freqCounterHaptics;
 // haptic thread
 cThread *hapticsThread;
 
+// poses written by the haptic thread at the end of each tick
+struct PoseFrame
+{
+	double time = -1.0;
+	// base of the tool, moved with the device in the board plane
+	cVector3d base;
+	cVector3d baseVelocity;
+	// device in world coordinates
+	cVector3d device;
+	cVector3d deviceVelocity;
+	cMatrix3d deviceRotation;
+	Motion hamsterMotion[9];
+	bool hamsterActive[9];
+	// score and the sequence number of the last hit, to trace when it shows
+	int hits = 0;
+	int misses = 0;
+	unsigned hitSequence = 0;
+};
+SeqLock<PoseFrame> poseChannel;
+
+// trace points of the haptic and graphics threads, on with --trace
+Tracer tracer;
+string tracePath = "hamstercide_trace.json";
+// sequence number of the last hit, counted by the haptic thread
+unsigned hitSequence = 0;
+// hit of the last frame read by the graphics thread
+PoseFrame shownFrame;
+
+// extrapolation of the published poses to the time the frame is shown
+PosePredictor basePredictor(4, 0.05);
+PosePredictor devicePredictor(4, 0.05);
+ScanoutClock scanoutClock;
+
+// jitter of the haptic loop against a 1 kHz period, misses past 2 ms are logged
+JitterMonitor hapticJitter(0.001, 0.002);
+
+// quality of the haptic loop from the cost of its ticks against a 1 kHz period
+QualityController hapticQuality(0.001, QUALITY_LEVELS);
+int qualityLevel = QUALITY_FULL;
+
+// ticks between hamster logic updates at reduced quality
+const int reducedLogicInterval = 4;
+
+// keeps the contact and hit forces passive whatever the rate of the loop
+PassivityController passivity;
+
+// scale from the physical workspace of the device to the virtual one
+double workspaceScaleFactor = 1.0;
+
+// reads the device once per tick and estimates its velocity
+DeviceSampler deviceSampler;
+
 // a handle to window display context
 GLFWwindow *window = NULL;
 
@@ -130,6 +293,24 @@ int height = 0;
 // swap interval for the display context (vertical synchronization)
 int swapInterval = 1;
 
+// frames the GPU may still be drawing while the next one is prepared
+FramePipeline framePipeline(2);
+// starts the work of a frame as late as its measured time allows
+FramePacer framePacer;
+
+// values shown by the labels, their text is laid out again only on a change
+struct HudValues
+{
+	int graphicsRate = -1;
+	int hapticsRate = -1;
+	int quality = -1;
+	int hits = -1;
+	int misses = -1;
+	int width = -1;
+	int height = -1;
+};
+HudValues hud;
+
 // root resource path
 string resourceRoot;
 
@@ -139,14 +320,28 @@ double toolRadius = 0.2;
 //------------------------------------------------------------------------------
 // GAME VARIABLES
 //------------------------------------------------------------------------------
-int hits;
-int misses;
 int score;
 int hiscore;
 
-bool raised = true;
 bool vibrate = false;
 
+// a flag set by the user to start a new round at the next haptic tick
+atomic<bool> restartRequested(false);
+
+// game clock shared by all timestamped game events [s]
+cPrecisionClock gameClock;
+
+// hamsters, their behaviours and the score, seeded from the start time
+GameInstance game(GameConfig(), (uint64_t)time(NULL));
+
+// hamsters placed by the last pose update, the next one sets the end pose of
+// those that landed in between
+vector<int> hamstersPosed;
+
+// headless games played by bots instead of the interactive one
+bool batchMode = false;
+BatchConfig batchConfig;
+
 cVector3d camPos = cVector3d(2.0, 0.0, 1.5);
 cVector3d camLook = cVector3d(0.0, 0.0, 0.0);
 
@@ -161,7 +356,52 @@ cVector3d camLook = cVector3d(0.0, 0.0, 0.0);
 // DECLARED FUNCTIONS
 //------------------------------------------------------------------------------
 
-void startGame();
+// creates the pooled hamster objects once
+void createHamsters();
+
+// resets states, positions, scores and behaviours in place for a new round
+void startGame(double time);
+
+// copies the triangles of a mesh into a flat BVH in the frame of the mesh
+void buildFlatBVH(cMultiMesh *object, FlatBVH &bvh);
+
+// computes the contact force of the tool sphere against the board backend
+bool computeBoardContact(const DeviceSample &sample, cVector3d &force);
+
+// computes the contact force of the tool sphere against the shared hamster
+// tree and returns the hamster touched deepest
+bool computeHamsterContact(const DeviceSample &sample, cVector3d &force, cGenericObject *&touched);
+
+// samples the head of the hammer as contact points in its frame
+void buildHammerShell(cMultiMesh *object, PointShell &shell);
+
+// computes the force and torque on the hammer head from all its contact
+// points and returns the object touched, hamsters first
+bool computeHammerContact(const DeviceSample &sample, cVector3d &force, cVector3d &torque, cGenericObject *&touched);
+
+// true when the board is touched through its distance field
+bool useBoardSDF();
+
+// switches the features of the haptic loop to the given quality level
+void applyQualityLevel(int level);
+
+// mutes or restores the friction sounds of the board and hamsters
+void setFrictionAudio(bool enabled);
+
+// evaluates the motion of the hamsters in flight and places their objects
+void updateHamsterPoses(double time);
+
+// places the object of one hamster at its height at the given time
+void placeHamster(int id, double time);
+
+// hands the poses of the current haptic tick to the graphics thread
+void publishPoses(double time, const DeviceSample &sample);
+
+// places the camera, hammer and hamsters at their pose predicted for scan-out
+void updatePredictedPoses(double time);
+
+// adds a hamster to or removes it from the collision and render traversal
+void setHamsterActive(int i, int j, bool active);
 
 // callback when the window display is resized
 void windowSizeCallback(GLFWwindow *a_window, int a_width, int a_height);
@@ -201,13 +441,104 @@ int main(int argc, char *argv[])
 		 << endl;
 	cout << "[f] - Enable/Disable full screen mode" << endl;
 	cout << "[m] - Enable/Disable vertical mirroring" << endl;
+	cout << "[r] - Start a new round" << endl;
 	cout << "[q] - Exit application" << endl;
+	cout << endl;
+	cout << "Command Line Options:" << endl
+		 << endl;
+	cout << "--realtime[=core] - Run the haptic thread in real-time mode" << endl;
+	cout << "--board=aabb|bvh|sdf - Select the collision backend of the board and hamsters" << endl;
+	cout << "--hammer=sphere|points - Select the haptic shape of the hammer" << endl;
+	cout << "--batch[=games] - Play headless games with a bot and report statistics" << endl;
+	cout << "--batch-time=seconds, --threads=n, --seed=n - Length, threads and seed of the batch" << endl;
+	cout << "--trace[=file] - Trace hit feedback latencies and export them as Chrome trace JSON" << endl;
 	cout << endl
 		 << endl;
 
 	// parse first arg to try and locate resources
 	resourceRoot = string(argv[0]).substr(0, string(argv[0]).find_last_of("/\\") + 1);
 
+	// parse remaining args
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if (arg == "--realtime" || arg.find("--realtime=") == 0)
+		{
+			realtimeMode = true;
+			if (arg.size() > 11)
+			{
+				// a core that does not parse or does not exist keeps the default
+				string value = arg.substr(11);
+				char *end = NULL;
+				long core = strtol(value.c_str(), &end, 10);
+				long cores = (long)thread::hardware_concurrency();
+				if (*end != '\0' || core < 0 || (cores > 0 && core >= cores))
+				{
+					cout << "invalid core \"" << value << "\" for --realtime, using core " << realtimeCore << endl;
+				}
+				else
+				{
+					realtimeCore = (int)core;
+				}
+			}
+		}
+		else if (arg == "--board=aabb")
+		{
+			boardCollision = BOARD_COLLISION_AABB;
+		}
+		else if (arg == "--board=bvh")
+		{
+			boardCollision = BOARD_COLLISION_FLAT_BVH;
+		}
+		else if (arg == "--board=sdf")
+		{
+			boardCollision = BOARD_COLLISION_SDF;
+		}
+		else if (arg == "--hammer=sphere")
+		{
+			hammerContact = HAMMER_CONTACT_SPHERE;
+		}
+		else if (arg == "--hammer=points")
+		{
+			hammerContact = HAMMER_CONTACT_POINTS;
+		}
+		else if (arg.find("--batch-time=") == 0)
+		{
+			batchConfig.duration = atof(arg.substr(13).c_str());
+		}
+		else if (arg.find("--batch") == 0)
+		{
+			batchMode = true;
+			if (arg.size() > 8)
+			{
+				batchConfig.instances = atoi(arg.substr(8).c_str());
+			}
+		}
+		else if (arg.find("--threads=") == 0)
+		{
+			batchConfig.threads = atoi(arg.substr(10).c_str());
+		}
+		else if (arg.find("--seed=") == 0)
+		{
+			batchConfig.seed = strtoull(arg.substr(7).c_str(), NULL, 10);
+		}
+		else if (arg.find("--trace") == 0)
+		{
+			tracer.setEnabled(true);
+			if (arg.size() > 8)
+			{
+				tracePath = arg.substr(8);
+			}
+		}
+	}
+
+	// headless games need neither a window nor a device
+	if (batchMode)
+	{
+		runBatch(batchConfig, cout);
+		return 0;
+	}
+
 	//--------------------------------------------------------------------------
 	// OPEN GL - WINDOW DISPLAY
 	//--------------------------------------------------------------------------
@@ -296,6 +627,10 @@ int main(int argc, char *argv[])
 	camera = new cCamera(world);
 	world->addChild(camera);
 
+	// branch of the world left to the graphics thread
+	renderRoot = new cGenericObject();
+	world->addChild(renderRoot);
+
 	// define a basis in spherical coordinates for the camera
 	camera->set(camPos,					   // camera position (eye)
 				camLook,				   // look at position (target)
@@ -385,11 +720,17 @@ int main(int argc, char *argv[])
 
 	// read the scale factor between the physical workspace of the haptic
 	// device and the virtual workspace defined for the tool
-	double workspaceScaleFactor = tool->getWorkspaceScaleFactor();
+	workspaceScaleFactor = tool->getWorkspaceScaleFactor();
 
 	// stiffness properties
 	double maxStiffness = hapticDeviceInfo.m_maxLinearStiffness / workspaceScaleFactor;
 
+	// damping added for passivity is bounded by what the device renders
+	passivity = PassivityController(hapticDeviceInfo.m_maxLinearDamping);
+
+	// the velocity filter works on the physical motion of the device
+	deviceSampler.setWorkspaceScale(workspaceScaleFactor);
+
 	//--------------------------------------------------------------------------
 	// SETUP AUDIO MATERIAL
 	//--------------------------------------------------------------------------
@@ -455,7 +796,7 @@ int main(int argc, char *argv[])
 	// set audio properties
 	for (int i = 0; i < (game_world->getNumMeshes()); i++) {
 		(game_world->getMesh(i))->m_material->setAudioFrictionBuffer(audioGroundTouch);
-		(game_world->getMesh(i))->m_material->setAudioFrictionGain(0.4);
+		(game_world->getMesh(i))->m_material->setAudioFrictionGain(groundFrictionGain);
 		(game_world->getMesh(i))->m_material->setAudioFrictionPitchGain(0.2);
 		(game_world->getMesh(i))->m_material->setAudioFrictionPitchOffset(0);
 		(game_world->getMesh(i))->m_material->setAudioImpactBuffer(audioGroundImpact);
@@ -465,20 +806,74 @@ int main(int argc, char *argv[])
 	// compute collision detection algorithm
 	game_world->createAABBCollisionDetector(toolRadius);
 
+	// hand board contact over to the flat BVH or distance field backend
+	boardStiffness = 0.9 * maxStiffness;
+	// the band covers a tool sphere sunk up to its center into the board
+	float boardSDFBand = (float)(2.0 * toolRadius);
+	string boardSDFPath = "resources/models/game_world.sdf";
+	if (boardCollision != BOARD_COLLISION_AABB || hammerContact == HAMMER_CONTACT_POINTS)
+	{
+		buildFlatBVH(game_world, boardBVH);
+		game_world->setHapticEnabled(false, true);
+
+		// a cached distance field serves as coarse fallback when the loop overruns
+		boardSDF.load(boardSDFPath, boardBVH.getHash(), boardSDFCell, boardSDFBand);
+	}
+	if (boardCollision == BOARD_COLLISION_SDF)
+	{
+		if (boardSDF.isEmpty())
+		{
+			cout << "baking distance field of the game board..." << endl;
+			boardSDF.bake(boardBVH, boardSDFCell, boardSDFBand);
+			if (!boardSDF.save(boardSDFPath))
+			{
+				cout << "failed to write " << boardSDFPath << endl;
+			}
+		}
+
+		// the tree is only needed for baking
+		boardBVH.clear();
+	}
+
+	// the coarse level only saves time when it swaps the tree for a field
+	hapticQuality.setLevelEnabled(QUALITY_COARSE_COLLISION,
+		boardCollision != BOARD_COLLISION_SDF && !boardSDF.isEmpty());
+
+	// cut the board into 8 x 8 tiles with their own levels of detail
+	boardLod.build(game_world, renderRoot, "resources/models/game_world.lod", 8, 8);
+
+	// add object to world
+	world->addChild(game_world);
+
 	//--------------------------------------------------------------------------
 	// Hamster Objects
 	//--------------------------------------------------------------------------
 
-	srand(time(NULL));
+	createHamsters();
+
+	// the hammer head, or the tool sphere when the board has its own backend,
+	// touches the hamsters through one tree of their mesh
+	if (hammerContact == HAMMER_CONTACT_POINTS || boardCollision != BOARD_COLLISION_AABB)
+	{
+		buildFlatBVH(hamsters[0][0], hamsterBVH);
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				hamsters[i][j]->setHapticEnabled(false, true);
+			}
+		}
+	}
 
-	startGame();
+	startGame(0.0);
 
 	//--------------------------------------------------------------------------
 	// Hammer Object
 	//--------------------------------------------------------------------------
 	hammer = new cMultiMesh();
-	// add hammer to tool
-	tool->m_image = hammer;
+	// the hammer is drawn by the graphics thread at the predicted device pose
+	// instead of as the tool image at the last haptic pose
+	renderRoot->addChild(hammer);
 	hammer->loadFromFile("resources/models/hammer.obj");
 
 	// compute collision detection algorithm
@@ -496,6 +891,18 @@ int main(int argc, char *argv[])
 
 	hammer->setUseCulling(false);
 
+	// the tool must not collide with its own image
+	hammer->setHapticEnabled(false, true);
+
+	hammerLod.build(hammer, renderRoot, "resources/models/hammer.lod");
+
+	if (hammerContact == HAMMER_CONTACT_POINTS)
+	{
+		buildHammerShell(hammer, hammerShell);
+		hammerShellLocal.resize(3 * hammerShell.getNumPoints());
+		hammerShellHits.resize(hammerShell.getNumPoints());
+	}
+
 	//--------------------------------------------------------------------------
 	// WIDGETS
 	//--------------------------------------------------------------------------
@@ -529,6 +936,15 @@ int main(int argc, char *argv[])
 	// START SIMULATION
 	//--------------------------------------------------------------------------
 
+	// start the clock that timestamps hamster motions
+	gameClock.start(true);
+
+	// lock memory before the haptic thread starts so it never page faults
+	if (realtimeMode)
+	{
+		lockMemory();
+	}
+
 	// create a thread which starts the main haptics rendering loop
 	hapticsThread = new cThread();
 	hapticsThread->start(updateHaptics, CTHREAD_PRIORITY_HAPTICS);
@@ -543,18 +959,76 @@ int main(int argc, char *argv[])
 	// call window size callback at initialization
 	windowSizeCallback(window, width, height);
 
+	// fences need the display context and its extensions
+	framePipeline.init();
+	double swapTime = gameClock.getCurrentTimeSeconds();
+
+	tracer.registerThread("graphics");
+	unsigned photonSequence = 0;
+	// hits shown by frames the GPU has not finished yet, with their frame
+	vector<pair<unsigned, long long>> pendingPhotons;
+
 	// main graphic loop
 	while (!glfwWindowShouldClose(window))
 	{
+		// sample the poses as late as the work of a frame allows
+		framePacer.wait(gameClock.getCurrentTimeSeconds(), swapTime, scanoutClock.getFramePeriod());
+
+		// bound the frames queued on the GPU, the wait is part of the work
+		framePacer.beginWork(gameClock.getCurrentTimeSeconds());
+		framePipeline.beginFrame();
+		tracer.begin(TRACE_FRAME);
+
 		// get width and height of window
 		glfwGetWindowSize(window, &width, &height);
 
 		// render graphics
 		updateGraphics();
 
+		long long frame = framePipeline.endFrame();
+		framePacer.endWork(gameClock.getCurrentTimeSeconds());
+
 		// swap buffers
 		glfwSwapBuffers(window);
 
+		// the swap returns at a refresh, which paces the scan-out prediction
+		swapTime = gameClock.getCurrentTimeSeconds();
+		scanoutClock.swapped(swapTime);
+		tracer.end(TRACE_FRAME);
+		tracer.instant(TRACE_SWAP);
+
+		// the first frame with a new hit is traced once the GPU finished it,
+		// the swap may return while it is still queued
+		if (shownFrame.hitSequence != photonSequence)
+		{
+			photonSequence = shownFrame.hitSequence;
+			pendingPhotons.push_back(make_pair(photonSequence, frame));
+		}
+		framePipeline.poll();
+		while (!pendingPhotons.empty())
+		{
+			// without fences the swap chain holds the frames, so the swap is
+			// the last known point
+			long long done = tracer.now();
+			if (framePipeline.hasFences() && !framePipeline.getCompletionTime(pendingPhotons.front().second, done))
+			{
+				break;
+			}
+
+			// the refreshes fall on the swaps, the frame flips at the first
+			// one after the GPU finished it and lights the middle of the
+			// screen half a refresh later
+			long long traceNow = tracer.now();
+			double now = gameClock.getCurrentTimeSeconds();
+			double finished = now - 1e-9 * (traceNow - done);
+			double period = scanoutClock.getFramePeriod();
+			double flip = swapTime + ceil((finished - swapTime) / period) * period;
+			long long scanout = traceNow + (long long)(1e9 * (flip + 0.5 * period - now));
+			tracer.record(TRACE_PHOTON, TRACE_INSTANT, pendingPhotons.front().first, scanout);
+			pendingPhotons.erase(pendingPhotons.begin());
+		}
+		tracer.collect();
+
 		// process events
 		glfwPollEvents();
 
@@ -562,6 +1036,9 @@ int main(int argc, char *argv[])
 		freqCounterGraphics.signal(1);
 	}
 
+	// the fences still in flight need the context of the window
+	framePipeline.release();
+
 	// close window
 	glfwDestroyWindow(window);
 
@@ -572,13 +1049,9 @@ int main(int argc, char *argv[])
 	return 0;
 }
 
-void startGame() {
-
-
-	world->addChild(game_world);
+void createHamsters() {
 	for (int i = 0; i < 3; ++i)
 	{
-		hamsters.push_back(vector<cMultiMesh *>());
 		for (int j = 0; j < 3; ++j)
 		{
 			// create a virtual mesh
@@ -600,7 +1073,7 @@ void startGame() {
 			hamster->setShowBoundaryBox(false);
 
 			// define a default stiffness for the object
-			hamster->setStiffness(0.1 * 100, true);
+			hamster->setStiffness(hamsterStiffness, true);
 
 			// define some haptic friction properties
 			hamster->setFriction(0.4, 0.2, true);
@@ -608,16 +1081,13 @@ void startGame() {
 			// enable display list for faster graphic rendering
 			hamster->setUseDisplayList(true);
 
-			// set location of objects
-			hamster->setLocalPos(cVector3d((double)(i - 1) * 1, (double)(j - 1) * 1, -0.8));
-
 			// compute all edges of object for which adjacent triangles have more than 40 degree angle
 			hamster->computeAllEdges(40);
 
 			// set audio properties
 			for (int i = 0; i < (hamster->getNumMeshes()); i++) {
 				(hamster->getMesh(i))->m_material->setAudioFrictionBuffer(audioHamsterTouch);
-				(hamster->getMesh(i))->m_material->setAudioFrictionGain(0.8);
+				(hamster->getMesh(i))->m_material->setAudioFrictionGain(hamsterFrictionGain);
 				(hamster->getMesh(i))->m_material->setAudioFrictionPitchGain(0.8);
 				(hamster->getMesh(i))->m_material->setAudioFrictionPitchOffset(0.8);
 				(hamster->getMesh(i))->m_material->setAudioImpactBuffer(audioHamsterImpact);
@@ -627,100 +1097,645 @@ void startGame() {
 			// compute collision detection algorithm
 			hamster->createAABBCollisionDetector(toolRadius);
 
-			hamsters[i].push_back(hamster);
+			// draw a copy sharing the mesh data instead of the object touched by the tool
+			cMultiMesh *visual = hamster->copy(false, false, false, false);
+			visual->setHapticEnabled(false, true);
+			renderRoot->addChild(visual);
+			hamster->setShowEnabled(false, true);
+
+			// all hamsters draw the levels built for the first one
+			if (i == 0 && j == 0)
+			{
+				hamsterLods[i][j].build(visual, renderRoot, "resources/models/hamster.lod");
+			}
+			else
+			{
+				hamsterLods[i][j].share(visual, renderRoot, hamsterLods[0][0]);
+			}
+
+			hamsters[i][j] = hamster;
+			hamsterVisuals[i][j] = visual;
 		}
 	}
 }
 
 //------------------------------------------------------------------------------
 
-void windowSizeCallback(GLFWwindow *a_window, int a_width, int a_height)
-{
-	// update window size
-	width = a_width;
-	height = a_height;
-}
+void startGame(double time) {
+	// new behaviours and scores
+	game.start(time);
 
-//------------------------------------------------------------------------------
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			setHamsterActive(i, j, false);
 
-void errorCallback(int a_error, const char *a_description)
-{
-	cout << "Error: " << a_description << endl;
+			// set location of objects
+			double x, y;
+			game.getPosition(i * 3 + j, x, y);
+			hamsters[i][j]->setLocalPos(cVector3d(x, y, game.getHeight(i * 3 + j, time)));
+		}
+	}
+
+	// all of them rest under the board, the list keeps its room for nine
+	hamstersPosed.clear();
+	hamstersPosed.reserve(9);
+
+	// reset effects
+	vibrate = false;
 }
 
 //------------------------------------------------------------------------------
 
-void keyCallback(GLFWwindow *a_window, int a_key, int a_scancode, int a_action, int a_mods)
+void buildFlatBVH(cMultiMesh *object, FlatBVH &bvh)
 {
-	// filter calls that only include a key press
-	if ((a_action != GLFW_PRESS) && (a_action != GLFW_REPEAT))
-	{
-		return;
-	}
-
-	// option - exit
-	else if ((a_key == GLFW_KEY_ESCAPE) || (a_key == GLFW_KEY_Q))
+	bvh.clear();
+	for (int m = 0; m < object->getNumMeshes(); m++)
 	{
-		glfwSetWindowShouldClose(a_window, GLFW_TRUE);
+		cMesh *mesh = object->getMesh(m);
+		cVector3d meshPos = mesh->getLocalPos();
+		cMatrix3d meshRot = mesh->getLocalRot();
+		for (int t = 0; t < mesh->getNumTriangles(); t++)
+		{
+			unsigned int ids[3] = { mesh->m_triangles->getVertexIndex0(t),
+									mesh->m_triangles->getVertexIndex1(t),
+									mesh->m_triangles->getVertexIndex2(t) };
+			float corners[3][3];
+			for (int v = 0; v < 3; v++)
+			{
+				cVector3d p = meshPos + meshRot * mesh->m_vertices->getLocalPos(ids[v]);
+				corners[v][0] = (float)p.x();
+				corners[v][1] = (float)p.y();
+				corners[v][2] = (float)p.z();
+			}
+			bvh.addTriangle(corners[0], corners[1], corners[2]);
+		}
 	}
+	bvh.build();
+}
 
-	// option - toggle fullscreen
-	else if (a_key == GLFW_KEY_F)
-	{
-		// toggle state variable
-		fullscreen = !fullscreen;
-
-		// get handle to monitor
-		GLFWmonitor *monitor = glfwGetPrimaryMonitor();
+//------------------------------------------------------------------------------
 
-		// get information about monitor
-		const GLFWvidmode *mode = glfwGetVideoMode(monitor);
+bool computeBoardContact(const DeviceSample &sample, cVector3d &force)
+{
+	// the board is never rotated, so its frame is only offset
+	cVector3d pos = sample.globalPosition - game_world->getLocalPos();
+	float p[3] = { (float)pos.x(), (float)pos.y(), (float)pos.z() };
 
-		// set fullscreen or window mode
-		if (fullscreen)
+	// one trilinear lookup gives both the depth and the normal
+	if (useBoardSDF())
+	{
+		float distance;
+		float gradient[3];
+		if (!boardSDF.query(p, distance, gradient) || distance >= toolRadius)
 		{
-			glfwSetWindowMonitor(window, monitor, 0, 0, mode->width, mode->height, mode->refreshRate);
-			glfwSwapInterval(swapInterval);
+			return false;
 		}
-		else
+		cVector3d normal(gradient[0], gradient[1], gradient[2]);
+		if (normal.length() == 0.0)
 		{
-			int w = 0.8 * mode->height;
-			int h = 0.5 * mode->height;
-			int x = 0.5 * (mode->width - w);
-			int y = 0.5 * (mode->height - h);
-			glfwSetWindowMonitor(window, NULL, x, y, w, h, mode->refreshRate);
-			glfwSwapInterval(swapInterval);
+			return false;
 		}
+		normal.normalize();
+		force = boardStiffness * (toolRadius - distance) * normal;
+		return true;
 	}
 
-	// option - toggle vertical mirroring
-	else if (a_key == GLFW_KEY_M)
+	BVHHit hit;
+	if (!boardBVH.closestPoint(p, (float)toolRadius, hit))
 	{
-		mirroredDisplay = !mirroredDisplay;
-		camera->setMirrorVertical(mirroredDisplay);
+		return false;
 	}
+
+	// push the tool sphere out to the front of the closest triangle, the
+	// distance is negative once its center has crossed the face
+	double depth = toolRadius - hit.distance;
+	force = boardStiffness * depth * cVector3d(hit.normal[0], hit.normal[1], hit.normal[2]);
+	return true;
 }
 
 //------------------------------------------------------------------------------
 
-void close(void)
+bool computeHamsterContact(const DeviceSample &sample, cVector3d &force, cGenericObject *&touched)
 {
-	// stop the simulation
-	simulationRunning = false;
-
-	// wait for graphics and haptics loops to terminate
-	while (!simulationFinished)
+	force.zero();
+	touched = NULL;
+	double deepest = 0.0;
+	for (int i = 0; i < 3; ++i)
 	{
-		cSleepMs(100);
+		for (int j = 0; j < 3; ++j)
+		{
+			if (!hamsterActive[i][j])
+			{
+				continue;
+			}
+
+			// the hamsters are only offset, like the board
+			cVector3d pos = sample.globalPosition - hamsters[i][j]->getLocalPos();
+			float p[3] = { (float)pos.x(), (float)pos.y(), (float)pos.z() };
+			BVHHit hit;
+			if (!hamsterBVH.closestPoint(p, (float)toolRadius, hit))
+			{
+				continue;
+			}
+
+			double depth = toolRadius - hit.distance;
+			force += hamsterStiffness * depth * cVector3d(hit.normal[0], hit.normal[1], hit.normal[2]);
+			if (depth > deepest)
+			{
+				deepest = depth;
+				touched = hamsters[i][j];
+			}
+		}
 	}
+	return touched != NULL;
+}
 
-	// close haptic device
-	tool->stop();
+//------------------------------------------------------------------------------
 
-	// delete resources
-	delete hapticsThread;
-	delete world;
-	delete handler;
+bool useBoardSDF()
+{
+	// the field also stands in for the tree when the loop runs at coarse quality
+	return boardCollision == BOARD_COLLISION_SDF ||
+		(qualityLevel >= QUALITY_COARSE_COLLISION && !boardSDF.isEmpty());
+}
+
+//------------------------------------------------------------------------------
+
+void buildHammerShell(cMultiMesh *object, PointShell &shell)
+{
+	shell.clear();
+	for (int m = 0; m < object->getNumMeshes(); m++)
+	{
+		cMesh *mesh = object->getMesh(m);
+		cVector3d meshPos = mesh->getLocalPos();
+		cMatrix3d meshRot = mesh->getLocalRot();
+		for (int t = 0; t < mesh->getNumTriangles(); t++)
+		{
+			unsigned int ids[3] = { mesh->m_triangles->getVertexIndex0(t),
+									mesh->m_triangles->getVertexIndex1(t),
+									mesh->m_triangles->getVertexIndex2(t) };
+			cVector3d p[3];
+			for (int v = 0; v < 3; v++)
+			{
+				p[v] = meshPos + meshRot * mesh->m_vertices->getLocalPos(ids[v]);
+			}
+
+			// the handle reaches far past the head and is left out
+			if (((p[0] + p[1] + p[2]) / 3.0).length() > hammerHeadReach)
+			{
+				continue;
+			}
+			float corners[3][3];
+			for (int v = 0; v < 3; v++)
+			{
+				corners[v][0] = (float)p[v].x();
+				corners[v][1] = (float)p[v].y();
+				corners[v][2] = (float)p[v].z();
+			}
+			shell.addTriangle(corners[0], corners[1], corners[2], hammerShellSpacing);
+		}
+	}
+	shell.weld(hammerShellSpacing);
+}
+
+//------------------------------------------------------------------------------
+
+bool computeHammerContact(const DeviceSample &sample, cVector3d &force, cVector3d &torque, cGenericObject *&touched)
+{
+	// the shell follows the device pose the hammer is drawn at
+	cVector3d center = sample.globalPosition;
+	cMatrix3d rot = sample.globalRotation;
+	cVector3d axes[3] = { rot * cVector3d(1, 0, 0), rot * cVector3d(0, 1, 0), rot * cVector3d(0, 0, 1) };
+	float position[3] = { (float)center.x(), (float)center.y(), (float)center.z() };
+	float axis[3][3];
+	for (int k = 0; k < 3; k++)
+	{
+		axis[k][0] = (float)axes[k].x();
+		axis[k][1] = (float)axes[k].y();
+		axis[k][2] = (float)axes[k].z();
+	}
+	hammerShell.transform(position, axis[0], axis[1], axis[2]);
+
+	const float *points = hammerShell.getPoints();
+	int count = hammerShell.getNumPoints();
+	float radius = hammerShell.getRadius();
+	// points behind a face are found down to the depth they are followed to
+	float reach = radius + hammerShellDepth;
+	float *local = hammerShellLocal.data();
+	BVHHit *hits = hammerShellHits.data();
+
+	force = cVector3d(0, 0, 0);
+	torque = cVector3d(0, 0, 0);
+	touched = NULL;
+	int contacts = 0;
+
+	// every point in contact pushes the head out and turns it about the device point
+	cVector3d objectForce(0, 0, 0);
+	cVector3d objectTorque(0, 0, 0);
+	int objectContacts = 0;
+	auto addContact = [&](int i, double depth, const float normal[3], double stiffness)
+	{
+		cVector3d f = stiffness * depth * cVector3d(normal[0], normal[1], normal[2]);
+		cVector3d arm = cVector3d(points[3 * i], points[3 * i + 1], points[3 * i + 2]) - center;
+		objectForce += f;
+		objectTorque += cCross(arm, f);
+		objectContacts++;
+	};
+
+	// the points on one object are averaged, so a face keeps its stiffness
+	// however many touch it, and the objects add up
+	auto endObject = [&]()
+	{
+		if (objectContacts > 0)
+		{
+			force += objectForce / (double)objectContacts;
+			torque += objectTorque / (double)objectContacts;
+			contacts += objectContacts;
+		}
+		objectForce.zero();
+		objectTorque.zero();
+		objectContacts = 0;
+	};
+
+	// moves the points into the frame of a target offset by pos
+	auto toLocal = [&](const cVector3d &pos)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			local[3 * i] = points[3 * i] - (float)pos.x();
+			local[3 * i + 1] = points[3 * i + 1] - (float)pos.y();
+			local[3 * i + 2] = points[3 * i + 2] - (float)pos.z();
+		}
+	};
+
+	// box around all points, shared by the tests against every hamster
+	float lo[3] = { position[0], position[1], position[2] };
+	float hi[3] = { position[0], position[1], position[2] };
+	for (int i = 0; i < count; i++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			lo[k] = cMin(lo[k], points[3 * i + k] - radius);
+			hi[k] = cMax(hi[k], points[3 * i + k] + radius);
+		}
+	}
+
+	// board
+	toLocal(game_world->getLocalPos());
+	if (useBoardSDF())
+	{
+		for (int i = 0; i < count; i++)
+		{
+			float distance;
+			float gradient[3];
+			if (boardSDF.query(&local[3 * i], distance, gradient) && distance < radius && distance > -hammerShellDepth)
+			{
+				float length = sqrtf(gradient[0] * gradient[0] + gradient[1] * gradient[1] + gradient[2] * gradient[2]);
+				if (length > 0.0f)
+				{
+					float normal[3] = { gradient[0] / length, gradient[1] / length, gradient[2] / length };
+					addContact(i, radius - distance, normal, boardStiffness);
+				}
+			}
+		}
+	}
+	else if (boardBVH.closestPoints(local, count, reach, hits) > 0)
+	{
+		// the distance is negative behind the face, so a point that crossed
+		// the surface keeps pushing out
+		for (int i = 0; i < count; i++)
+		{
+			if (hits[i].triangle >= 0 && hits[i].distance < radius)
+			{
+				addContact(i, radius - hits[i].distance, hits[i].normal, boardStiffness);
+			}
+		}
+	}
+	endObject();
+
+	// hamsters, only those whose bounds meet the box of the head
+	float hamsterMin[3], hamsterMax[3];
+	hamsterBVH.getBounds(hamsterMin, hamsterMax);
+	double deepest = 0.0;
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			if (!hamsterActive[i][j])
+			{
+				continue;
+			}
+			cVector3d pos = hamsters[i][j]->getLocalPos();
+			float offset[3] = { (float)pos.x(), (float)pos.y(), (float)pos.z() };
+			bool overlap = true;
+			for (int k = 0; k < 3; k++)
+			{
+				overlap = overlap && lo[k] <= hamsterMax[k] + offset[k] && hamsterMin[k] + offset[k] <= hi[k];
+			}
+			if (!overlap)
+			{
+				continue;
+			}
+
+			toLocal(pos);
+			if (hamsterBVH.closestPoints(local, count, reach, hits) == 0)
+			{
+				continue;
+			}
+			for (int p = 0; p < count; p++)
+			{
+				if (hits[p].triangle < 0 || hits[p].distance >= radius)
+				{
+					continue;
+				}
+				double depth = radius - hits[p].distance;
+				addContact(p, depth, hits[p].normal, hamsterStiffness);
+				if (depth > deepest)
+				{
+					deepest = depth;
+					touched = hamsters[i][j];
+				}
+			}
+			endObject();
+		}
+	}
+
+	if (contacts == 0)
+	{
+		return false;
+	}
+	if (touched == NULL)
+	{
+		touched = game_world;
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+void applyQualityLevel(int level)
+{
+	// only the friction sounds need their materials changed, the other levels
+	// are checked where their feature runs
+	bool frictionAudio = level < QUALITY_NO_FRICTION_AUDIO;
+	if (frictionAudio != (qualityLevel < QUALITY_NO_FRICTION_AUDIO))
+	{
+		setFrictionAudio(frictionAudio);
+	}
+	qualityLevel = level;
+}
+
+//------------------------------------------------------------------------------
+
+void setFrictionAudio(bool enabled)
+{
+	for (int i = 0; i < game_world->getNumMeshes(); i++)
+	{
+		game_world->getMesh(i)->m_material->setAudioFrictionGain(enabled ? groundFrictionGain : 0.0);
+	}
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			for (int k = 0; k < hamsters[i][j]->getNumMeshes(); k++)
+			{
+				hamsters[i][j]->getMesh(k)->m_material->setAudioFrictionGain(enabled ? hamsterFrictionGain : 0.0);
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void updateHamsterPoses(double time)
+{
+	// only hamsters in flight change, resting ones cost nothing here
+	const vector<int> &inFlight = game.getInFlight();
+	for (int id : hamstersPosed)
+	{
+		if (!game.isInFlight(id))
+		{
+			placeHamster(id, time);
+		}
+	}
+	for (int id : inFlight)
+	{
+		placeHamster(id, time);
+	}
+	hamstersPosed.assign(inFlight.begin(), inFlight.end());
+}
+
+void placeHamster(int id, double time)
+{
+	int i = id / 3;
+	int j = id % 3;
+	setHamsterActive(i, j, game.isActive(id));
+
+	double x, y;
+	game.getPosition(id, x, y);
+	hamsters[i][j]->setLocalPos(x, y, game.getHeight(id, time));
+}
+
+//------------------------------------------------------------------------------
+
+void publishPoses(double time, const DeviceSample &sample)
+{
+	PoseFrame frame;
+	frame.time = time;
+	frame.base = tool->getLocalPos();
+	frame.baseVelocity = cVector3d(sample.localVelocity.x(), sample.localVelocity.y(), 0.0);
+	frame.device = sample.globalPosition;
+	// the base moves along with the device, so both add up in the world
+	frame.deviceVelocity = sample.globalVelocity + frame.baseVelocity;
+	frame.deviceRotation = sample.globalRotation;
+	for (int k = 0; k < 9; k++)
+	{
+		frame.hamsterMotion[k] = game.getMotion(k);
+		frame.hamsterActive[k] = hamsterActive[k / 3][k % 3];
+	}
+	frame.hits = game.getHits();
+	frame.misses = game.getMisses();
+	frame.hitSequence = hitSequence;
+	poseChannel.write(frame);
+}
+
+//------------------------------------------------------------------------------
+
+void updatePredictedPoses(double time)
+{
+	PoseFrame frame;
+	poseChannel.read(frame);
+	if (frame.time < 0.0)
+	{
+		return;
+	}
+	shownFrame.hits = frame.hits;
+	shownFrame.misses = frame.misses;
+	shownFrame.hitSequence = frame.hitSequence;
+	basePredictor.addSample(frame.time, frame.base, frame.baseVelocity);
+	devicePredictor.addSample(frame.time, frame.device, frame.deviceVelocity);
+
+	double scanout = scanoutClock.predict(time);
+
+	// the camera follows the tool base
+	camera->setLocalPos(camPos + basePredictor.predict(scanout));
+
+	hammer->setLocalPos(devicePredictor.predict(scanout));
+	hammer->setLocalRot(frame.deviceRotation);
+
+	// the hamster curves are known ahead, so they are evaluated exactly
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			// hamsters resting under the board are not drawn at all
+			hamsterLods[i][j].setVisible(frame.hamsterActive[i * 3 + j]);
+			if (!frame.hamsterActive[i * 3 + j])
+			{
+				continue;
+			}
+			// the place on the board comes from the configuration, the haptic
+			// thread keeps writing the pose of the collision object
+			double x, y;
+			game.getPosition(i * 3 + j, x, y);
+			hamsterVisuals[i][j]->setLocalPos(x, y, frame.hamsterMotion[i * 3 + j].evaluate(scanout));
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void setHamsterActive(int i, int j, bool active)
+{
+	if (hamsterActive[i][j] == active)
+	{
+		return;
+	}
+	hamsterActive[i][j] = active;
+
+	// a disabled object is skipped with its children by the collision
+	// traversal, the graphics thread follows with the drawn copy
+	hamsters[i][j]->setEnabled(active, true);
+}
+
+//------------------------------------------------------------------------------
+
+void windowSizeCallback(GLFWwindow *a_window, int a_width, int a_height)
+{
+	// update window size
+	width = a_width;
+	height = a_height;
+}
+
+//------------------------------------------------------------------------------
+
+void errorCallback(int a_error, const char *a_description)
+{
+	cout << "Error: " << a_description << endl;
+}
+
+//------------------------------------------------------------------------------
+
+void keyCallback(GLFWwindow *a_window, int a_key, int a_scancode, int a_action, int a_mods)
+{
+	// filter calls that only include a key press
+	if ((a_action != GLFW_PRESS) && (a_action != GLFW_REPEAT))
+	{
+		return;
+	}
+
+	// option - exit
+	else if ((a_key == GLFW_KEY_ESCAPE) || (a_key == GLFW_KEY_Q))
+	{
+		glfwSetWindowShouldClose(a_window, GLFW_TRUE);
+	}
+
+	// option - toggle fullscreen
+	else if (a_key == GLFW_KEY_F)
+	{
+		// toggle state variable
+		fullscreen = !fullscreen;
+
+		// get handle to monitor
+		GLFWmonitor *monitor = glfwGetPrimaryMonitor();
+
+		// get information about monitor
+		const GLFWvidmode *mode = glfwGetVideoMode(monitor);
+
+		// set fullscreen or window mode
+		if (fullscreen)
+		{
+			glfwSetWindowMonitor(window, monitor, 0, 0, mode->width, mode->height, mode->refreshRate);
+			glfwSwapInterval(swapInterval);
+		}
+		else
+		{
+			int w = 0.8 * mode->height;
+			int h = 0.5 * mode->height;
+			int x = 0.5 * (mode->width - w);
+			int y = 0.5 * (mode->height - h);
+			glfwSetWindowMonitor(window, NULL, x, y, w, h, mode->refreshRate);
+			glfwSwapInterval(swapInterval);
+		}
+	}
+
+	// option - toggle vertical mirroring
+	else if (a_key == GLFW_KEY_M)
+	{
+		mirroredDisplay = !mirroredDisplay;
+		camera->setMirrorVertical(mirroredDisplay);
+	}
+
+	// option - start a new round
+	else if (a_key == GLFW_KEY_R)
+	{
+		restartRequested = true;
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void close(void)
+{
+	// stop the simulation
+	simulationRunning = false;
+
+	// wait for graphics and haptics loops to terminate
+	while (!simulationFinished)
+	{
+		cSleepMs(100);
+	}
+
+	// close haptic device
+	tool->stop();
+
+	if (realtimeMode)
+	{
+		hapticJitter.printSummary(cout);
+	}
+	hapticQuality.printSummary(cout);
+	passivity.printSummary(cout);
+	framePacer.printSummary(cout, framePipeline);
+
+	if (tracer.isEnabled())
+	{
+		tracer.printLatencies(cout);
+		if (tracer.exportChrome(tracePath))
+		{
+			cout << "trace: written to " << tracePath << endl;
+		}
+		else
+		{
+			cout << "trace: failed to write " << tracePath << endl;
+		}
+	}
+
+	// delete resources
+	delete hapticsThread;
+	delete world;
+	delete handler;
 	delete audioDevice;
 	delete audioGroundImpact;
 	delete audioGroundTouch;
@@ -737,36 +1752,82 @@ void updateGraphics(void)
 	// UPDATE WIDGETS
 	/////////////////////////////////////////////////////////////////////
 
+	// extrapolate the latest haptic poses to when this frame is shown
+	updatePredictedPoses(gameClock.getCurrentTimeSeconds());
+
 	// update haptic and graphic rate data
-	labelRates->setText(cStr(freqCounterGraphics.getFrequency(), 0) + " Hz / " +
-						cStr(freqCounterHaptics.getFrequency(), 0) + " Hz");
+	int graphicsRate = (int)(freqCounterGraphics.getFrequency() + 0.5);
+	int hapticsRate = (int)(freqCounterHaptics.getFrequency() + 0.5);
+	int quality = hapticQuality.getLevel();
+	bool resized = width != hud.width || height != hud.height;
+	if (resized || graphicsRate != hud.graphicsRate || hapticsRate != hud.hapticsRate || quality != hud.quality)
+	{
+		string rates = to_string(graphicsRate) + " Hz / " + to_string(hapticsRate) + " Hz";
+		if (quality != QUALITY_FULL)
+		{
+			rates += " (quality " + to_string(quality) + ")";
+		}
+		labelRates->setText(rates);
+
+		// update position of label
+		labelRates->setLocalPos((int)(0.5 * (width - labelRates->getWidth())), 15);
+
+		hud.graphicsRate = graphicsRate;
+		hud.hapticsRate = hapticsRate;
+		hud.quality = quality;
+	}
 
-	// update position of label
-	labelRates->setLocalPos((int)(0.5 * (width - labelRates->getWidth())), 15);
+	// update scores, as published with the poses of the frame
+	int hits = shownFrame.hits;
+	int misses = shownFrame.misses;
+	if (hits != hud.hits)
+	{
+		tracer.instant(TRACE_HUD, shownFrame.hitSequence);
+	}
+	if (resized || hits != hud.hits || misses != hud.misses)
+	{
+		labelScore->setText("HITS: " + to_string(hits) + " " + "MISSES: " + to_string(misses));
 
-	// update scores
-	labelScore->setText("HITS: " + to_string(hits) + " " + "MISSES: " + to_string(misses));
+		// update position of label
+		labelScore->setLocalPos((int)(0.5 * (width - labelScore->getWidth())), 0.925 * height);
 
-	// update position of label
-	labelScore->setLocalPos((int)(0.5 * (width - labelScore->getWidth())), 0.925 * height);
+		hud.hits = hits;
+		hud.misses = misses;
+	}
+	hud.width = width;
+	hud.height = height;
 
 	/////////////////////////////////////////////////////////////////////
 	// RENDER SCENE
 	/////////////////////////////////////////////////////////////////////
 
+	// pick the level of detail of every object from its size on screen
+	boardLod.update(camera, height, lodMaxPixels);
+	hammerLod.update(camera, height, lodMaxPixels);
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			hamsterLods[i][j].update(camera, height, lodMaxPixels);
+		}
+	}
+
 	// update shadow maps (if any)
 	world->updateShadowMaps(false, mirroredDisplay);
 
-	// render world
+	// render world, the GPU finishes it while the next frame is prepared
 	camera->renderView(width, height);
 
-	// wait until all GL commands are completed
-	glFinish();
-
 	// check for any OpenGL errors
 	GLenum err = glGetError();
 	if (err != GL_NO_ERROR)
 		cout << "Error: " << gluErrorString(err) << endl;
+
+	// log deadline misses of the haptic thread outside of the force loop
+	if (realtimeMode)
+	{
+		hapticJitter.printMisses(cout);
+	}
 }
 
 //------------------------------------------------------------------------------
@@ -788,107 +1849,70 @@ void updateHaptics(void)
 	simulationRunning = true;
 	simulationFinished = false;
 
+	// pin this thread, switch it to SCHED_FIFO and fault in its stack
+	if (realtimeMode)
+	{
+		enableRealtime(realtimeCore);
+		prefaultStack(256 * 1024);
+	}
+
+	// ticks after which the haptic path is expected to stop allocating
+	const long long warmupTicks = 1000;
+	long long tickCount = 0;
+
 	cPrecisionClock timeClock;
 	timeClock.start();
 
 	cPrecisionClock vibrateTimer;
 
-	cPrecisionClock forceClock;
-	forceClock.reset();
+	// the sample of the last tick until the device is read again
+	DeviceSample sample;
+	deviceSampler.sample(tool, timeClock.getCurrentTimeSeconds(), sample);
+	cVector3d devicePositionPrevious = sample.localPosition;
+
+	// the energy of a tick is exchanged over its actual length
+	double previousTickStart = timeClock.getCurrentTimeSeconds();
 
-	cVector3d devicePositionPrevious = tool->getDeviceLocalPos();
+	// the ring of this thread is allocated before the loop
+	tracer.registerThread("haptics");
+	unsigned vibrationSequence = 0;
 
 	// main haptic simulation loop
 	while (simulationRunning)
 	{
-		forceClock.stop();
-		double forceTimeInterval = forceClock.getCurrentTimeSeconds();
-		forceClock.reset();
-		forceClock.start();
+		double gameTime = gameClock.getCurrentTimeSeconds();
 
-		double vibrateInterval = vibrateTimer.getCurrentTimeSeconds();
+		double tickStart = timeClock.getCurrentTimeSeconds();
+		hapticJitter.tick(tickStart);
+		tracer.begin(TRACE_HAPTIC_TICK);
+		double tickPeriod = tickStart - previousTickStart;
+		previousTickStart = tickStart;
 
-		/////////////////////////////////////////////////////////////////////////
-		// Game Loop
-		/////////////////////////////////////////////////////////////////////////
-		// Reset missed flag when hammer moves up
-		if (tool->getDeviceLocalLinVel().z() > 4)
+		// count any allocation made by the force loop once it is warm
+		if (++tickCount == warmupTicks && realtimeMode)
 		{
-			raised = true;
+			setAllocationGuard(true);
 		}
 
+		// at reduced quality the hamster logic only runs every few ticks
+		bool logicTick = qualityLevel < QUALITY_REDUCED_LOGIC || tickCount % reducedLogicInterval == 0;
+
+		double vibrateInterval = vibrateTimer.getCurrentTimeSeconds();
+
 		/////////////////////////////////////////////////////////////////////////
 		// Hamster Movements
 		/////////////////////////////////////////////////////////////////////////
 
-		for (int k = 0; k < 25; k++)
+		// a new round reuses every object and only resets its state
+		if (restartRequested.exchange(false))
 		{
-			int i = rand() % 3;
-			int j = rand() % 3;
-			cVector3d hamsterPos = hamsters[i][j]->getLocalPos();
-			// Hamster is in bottom position
-			if (hamsterState[i][j] == 0)
-			{
-				int random = (rand() % 10000) + 1;
-				if (random <= 2)
-				{
-					hamsterState[i][j] = 1;
-				}
-			}
-			// Hamster is in moving upwards
-			else if (hamsterState[i][j] == 1)
-			{
-				// And is not at the top yet
-				if (hamsterPos.z() < -0.199)
-				{
-					hamsters[i][j]->translate(cVector3d(0.0, 0.0, 0.001));
-				}
-				// And is at the top
-				else
-				{
-					hamsterState[i][j] = 2;
-				}
-			}
-			// Hamster is at the top
-			else if (hamsterState[i][j] == 2)
-			{
-				int random = (rand() % 10000) + 1;
-				if (random <= 4)
-				{
-					hamsterState[i][j] = 4;
-				}
-			}
-			// Hamster is moving downwards
-			else if (hamsterState[i][j] == 3) {
-				// And is not at the bottom yet
-				if (hamsterPos.z() > -0.8) {
-					hamsters[i][j]->translate(cVector3d(0.0, 0.0, -0.001));
-				}
-				// And is at the bottom
-				else
-				{
-					hamsterState[i][j] = 0;
-				}
-			}
-			// Hamster is knocked out
-			else
-			{
-				// But is not at the bottom
-				if (hamsterPos.z() > -0.8)
-				{
-					// Then move to the bottom
-					hamsters[i][j]->translate(cVector3d(0.0, 0.0, -0.0015));
-				}
-				else
-				{
-					// Low chance of hamster coming back to bottom state
-					int random = (rand() % 10000) + 1;
-					if (random <= 1)
-					{
-						hamsterState[i][j] = 0;
-					}
-				}
-			}
+			startGame(gameTime);
+		}
+
+		// only the behaviours whose wait is over are resumed
+		if (logicTick)
+		{
+			game.advance(gameTime);
 		}
 
 		/////////////////////////////////////////////////////////////////////////
@@ -899,20 +1923,47 @@ void updateHaptics(void)
 		freqCounterHaptics.signal(1);
 
 		/////////////////////////////////////////
-		cVector3d devicePositionCurrent = tool->getDeviceLocalPos();
-		cVector3d deviceDelta = devicePositionCurrent - devicePositionPrevious;
-		devicePositionPrevious = devicePositionCurrent;
+		cVector3d deviceDelta = sample.localPosition - devicePositionPrevious;
+		devicePositionPrevious = sample.localPosition;
 
+		// the camera follows the tool base on the graphics thread
 		tool->translate(cVector3d(deviceDelta.x(), deviceDelta.y(), 0));
 
-		camera->translate(cVector3d(deviceDelta.x(), deviceDelta.y(), 0));
+		// place the hamsters in flight before the collision query needs them
+		if (logicTick)
+		{
+			updateHamsterPoses(gameTime);
+		}
 
-		// compute global reference frames for each object
-		world->computeGlobalPositions(true);
+		// compute global reference frames of the objects that can be touched,
+		// the render-only branch is skipped
+		for (unsigned int k = 0; k < world->getNumChildren(); k++)
+		{
+			cGenericObject *child = world->getChild(k);
+			if (child != renderRoot)
+			{
+				child->computeGlobalPositions(true, world->getGlobalPos(), world->getGlobalRot());
+			}
+		}
 
-		// update position and orientation of tool
+		// update position and orientation of tool, the time the device takes
+		// to answer is left out of the cost of the tick
+		double deviceStart = timeClock.getCurrentTimeSeconds();
 		tool->updateFromDevice();
 
+		// everything below reads the device through this one sample
+		deviceSampler.sample(tool, tickStart, sample);
+		double deviceTime = timeClock.getCurrentTimeSeconds() - deviceStart;
+
+		/////////////////////////////////////////////////////////////////////////
+		// Game Loop
+		/////////////////////////////////////////////////////////////////////////
+		// Reset missed flag when hammer moves up
+		if (sample.localVelocity.z() > 4)
+		{
+			game.liftHammer();
+		}
+
 		// compute interaction forces
 		tool->computeInteractionForces();
 		//Calculate elapsed time
@@ -921,17 +1972,43 @@ void updateHaptics(void)
 			vibrate = false;
 		}
 
-		if (vibrate) {
-			// Vibration effect
-			double timer = timeClock.getCPUTimeSeconds();
+		// contact of the hammer head points with the board and the hamsters
+		cGenericObject *headContact = NULL;
+		if (hammerContact == HAMMER_CONTACT_POINTS)
+		{
+			cVector3d headForce, headTorque;
+			if (computeHammerContact(sample, headForce, headTorque, headContact))
+			{
+				tool->addDeviceLocalForce(headForce);
+				tool->addDeviceLocalTorque(headTorque);
+			}
+		}
 
-			double vibrateX = sin(2.0 * M_PI * 120.0 * timer);
-			double vibrateY = cos(2.0 * M_PI * 120.0 * timer);
+		// contact with the board when it has its own collision backend
+		bool boardContact = false;
+		if (boardCollision != BOARD_COLLISION_AABB && hammerContact == HAMMER_CONTACT_SPHERE)
+		{
+			cVector3d boardForce;
+			boardContact = computeBoardContact(sample, boardForce);
+			if (boardContact)
+			{
+				tool->addDeviceLocalForce(boardForce);
+			}
+		}
 
-			tool->addDeviceLocalForce(cVector3d(1.5* vibrateX, 1.5* vibrateY, 0.0));
+		// the hamsters share the flat tree whenever the board has one
+		cGenericObject *hamsterContact = NULL;
+		if (boardCollision != BOARD_COLLISION_AABB && hammerContact == HAMMER_CONTACT_SPHERE)
+		{
+			cVector3d hamsterForce;
+			if (computeHamsterContact(sample, hamsterForce, hamsterContact))
+			{
+				tool->addDeviceLocalForce(hamsterForce);
+			}
 		}
 
-		// When there is a collision
+		// Find the object in contact
+		collidedObject = NULL;
 		if (tool->m_hapticPoint->getNumCollisionEvents() > 0)
 		{
 			// get contact event
@@ -939,11 +2016,25 @@ void updateHaptics(void)
 
 			// get object from contact event
 			collidedObject = collisionEvent->m_object->getParent();
+		}
+		else if (hamsterContact != NULL)
+		{
+			collidedObject = hamsterContact;
+		}
+		else if (boardContact)
+		{
+			collidedObject = game_world;
+		}
+		else if (headContact != NULL)
+		{
+			collidedObject = headContact;
+		}
 
-			double zForce = tool->getDeviceGlobalForce().z();
-
+		// When there is a collision
+		if (collidedObject != NULL)
+		{
 			// Make sure the hammer movement was an attempt to hit something (It has to be fast enough)
-			if (tool->getDeviceLocalLinVel().z() < -9)
+			if (sample.localVelocity.z() < -9)
 			{
 				// If the collided object is a hamster
 				if (collidedObject->m_name[0] == 'h')
@@ -951,50 +2042,74 @@ void updateHaptics(void)
 					// Get the id of hamster hit
 					int hamsterID;
 					hamsterID = int(collidedObject->m_name[7]) - '0';
-					int i = hamsterID / 3;
-					int j = hamsterID % 3;
 					// If the hamster is not hiding
-					if (hamsterState[i][j] != 0)
+					if (game.getState(hamsterID) != 0)
 					{
-						// Apply reaction force
-						const double forceMultiplier = 6.0;
-						cVector3d pos = collidedObject->getLocalPos();
-
 						// Force effect
-						double ReactionForceY = cMax(pow(cAbs(tool->getDeviceLocalLinVel().z()), 1.2), 2.0);
-						cVector3d ReactionForce = cVector3d(-(tool->getDeviceLocalLinVel().x()), -(tool->getDeviceLocalLinVel().y()), -ReactionForceY);
+						double ReactionForceY = cMax(pow(cAbs(sample.localVelocity.z()), 1.2), 2.0);
+						cVector3d ReactionForce = cVector3d(-sample.localVelocity.x(), -sample.localVelocity.y(), -ReactionForceY);
 						tool->addDeviceLocalForce(ReactionForce);
 
-						// Move hamsters down forcefully
-						double posZ = cClamp(pos.z() - forceMultiplier * forceTimeInterval * zForce, -0.8, -0.2);
-						collidedObject->setLocalPos(pos.x(), pos.y(), posZ);
-
-						// Hammer is no longer in raised position
-						raised = false;
-
-						// If hamster is not knocked out
-						if (hamsterState[i][j] != 5)
+						// If hamster is not knocked out, its behaviour takes the hit
+						if (game.strikeHamster(hamsterID))
 						{
-							hamsterState[i][j] = 5;
+							tracer.instant(TRACE_HIT, ++hitSequence);
 							vibrateTimer.start();
 							vibrate = true;
-							hits++;
 							audioSourceHit->play();
+							tracer.instant(TRACE_SOUND, hitSequence);
 						}
 					}
 				}
 				// Missed hamster
-				else if (collidedObject->m_name[0] != 'h' && raised)
+				else if (collidedObject->m_name[0] != 'h')
 				{
-					raised = false;
-					misses++;
+					game.strikeBoard();
 				}
 			}
 		}
+		// damp the energy the contact and hit forces would generate, measured
+		// at the device with its physical velocity
+		cVector3d deviceForce = tool->getDeviceLocalForce();
+		cVector3d deviceVelocity = sample.localVelocity / workspaceScaleFactor;
+		tool->setDeviceLocalForce(passivity.apply(deviceForce, deviceVelocity, tickPeriod));
+
+		// the vibration is an intended active effect, added past the controller
+		if (vibrate && qualityLevel < QUALITY_NO_VIBRATION) {
+			// Vibration effect
+			double timer = timeClock.getCPUTimeSeconds();
+
+			double vibrateX = sin(2.0 * M_PI * 120.0 * timer);
+			double vibrateY = cos(2.0 * M_PI * 120.0 * timer);
+
+			tool->addDeviceLocalForce(cVector3d(1.5* vibrateX, 1.5* vibrateY, 0.0));
+		}
+
+		// degrade or recover from the cost of this tick: game logic, poses,
+		// contact, hit detection and the passivity controller, device I/O
+		// excluded
+		int level = hapticQuality.update(timeClock.getCurrentTimeSeconds() - tickStart - deviceTime);
+		if (level != qualityLevel)
+		{
+			applyQualityLevel(level);
+		}
+
 		// send forces to haptic device
 		tool->applyToDevice();
+
+		// the first tick that sent the vibration of a hit
+		if (vibrate && qualityLevel < QUALITY_NO_VIBRATION && vibrationSequence != hitSequence)
+		{
+			vibrationSequence = hitSequence;
+			tracer.instant(TRACE_VIBRATION, hitSequence);
+		}
+
+		publishPoses(gameTime, sample);
+		tracer.end(TRACE_HAPTIC_TICK);
 	}
 
+	setAllocationGuard(false);
+
 	// exit haptics thread
 	simulationFinished = true;
 }
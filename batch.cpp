@@ -0,0 +1,312 @@
+#include "batch.h"
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+WorkStealingPool::WorkStealingPool(int threads) : numThreads(threads), workers(0) {
+	if (numThreads <= 0) {
+		numThreads = (int)thread::hardware_concurrency();
+	}
+	if (numThreads <= 0) {
+		numThreads = 1;
+	}
+	workers = vector<Worker>(numThreads);
+}
+
+void WorkStealingPool::run(int jobs, const function<void(int, int)>& job) {
+	for (int w = 0; w < numThreads; w++) {
+		Worker& worker = workers[w];
+		worker.begin = (int)((long long)jobs * w / numThreads);
+		worker.end = (int)((long long)jobs * (w + 1) / numThreads);
+		worker.jobs = 0;
+		worker.steals = 0;
+	}
+
+	auto work = [&](int w) {
+		int index;
+		while (next(w, index)) {
+			job(index, w);
+		}
+	};
+
+	vector<thread> threads;
+	for (int w = 1; w < numThreads; w++) {
+		threads.emplace_back(work, w);
+	}
+	work(0);
+	for (thread& t : threads) {
+		t.join();
+	}
+}
+
+bool WorkStealingPool::next(int w, int& job) {
+	Worker& worker = workers[w];
+	while (true) {
+		{
+			lock_guard<mutex> guard(worker.lock);
+			if (worker.begin < worker.end) {
+				job = worker.begin++;
+				worker.jobs++;
+				return true;
+			}
+		}
+		// no job is ever added, so a worker that finds nothing left to steal
+		// can stop while the others finish what they hold
+		if (!steal(w)) {
+			return false;
+		}
+	}
+}
+
+bool WorkStealingPool::steal(int w) {
+	for (int k = 1; k < numThreads; k++) {
+		Worker& victim = workers[(w + k) % numThreads];
+		int begin, end;
+		{
+			lock_guard<mutex> guard(victim.lock);
+			int left = victim.end - victim.begin;
+			if (left <= 0) {
+				continue;
+			}
+			// the back half, far from where the owner is working
+			end = victim.end;
+			begin = end - (left + 1) / 2;
+			victim.end = begin;
+		}
+		Worker& worker = workers[w];
+		lock_guard<mutex> guard(worker.lock);
+		worker.begin = begin;
+		worker.end = end;
+		worker.steals++;
+		return true;
+	}
+	return false;
+}
+
+int WorkStealingPool::getNumThreads() const {
+	return numThreads;
+}
+
+long long WorkStealingPool::getNumJobs(int worker) const {
+	return workers[worker].jobs;
+}
+
+long long WorkStealingPool::getNumSteals(int worker) const {
+	return workers[worker].steals;
+}
+
+//------------------------------------------------------------------------------
+
+// Spreads consecutive seeds over the whole state space
+static uint64_t mixSeed(uint64_t x) {
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+class Bot {
+	enum Phase {
+		BOT_IDLE,
+		BOT_AIM,
+		BOT_STRIKE,
+		BOT_LIFT
+	};
+
+	const BotConfig& config;
+	const ArenaConfig& arena;
+	uint64_t rng;
+
+	Phase phase = BOT_IDLE;
+	double x = 0.0;
+	double y = 0.0;
+	double z;
+	int target = -1;
+	double decideTime = 0.0;
+	double aimX = 0.0;
+	double aimY = 0.0;
+
+	double random() {
+		rng ^= rng >> 12;
+		rng ^= rng << 25;
+		rng ^= rng >> 27;
+		return (double)((rng * 0x2545f4914f6cdd1dULL) >> 11) * (1.0 / 9007199254740992.0);
+	}
+
+	double gaussian() {
+		double u = 1.0 - random();
+		double v = random();
+		return sqrt(-2.0 * log(u)) * cos(6.283185307179586 * v);
+	}
+
+	static bool isVisible(const GameInstance& game, int id) {
+		return game.getState(id) == 1 || game.getState(id) == 2;
+	}
+
+	// Returns the hamster under the hammer head, -1 if none
+	int findContact(const GameInstance& game, double time) const {
+		double bottom = z - arena.headRadius;
+		double reach = arena.headRadius + arena.hamsterRadius;
+		for (int id = 0; id < game.getNumHamsters(); id++) {
+			if (!game.isActive(id)) {
+				continue;
+			}
+			// the pose is evaluated only for the hamsters the head could meet
+			double height = game.getHeight(id, time);
+			if (height <= arena.boardHeight || bottom > height) {
+				continue;
+			}
+			double hx, hy;
+			game.getPosition(id, hx, hy);
+			if ((hx - x) * (hx - x) + (hy - y) * (hy - y) <= reach * reach) {
+				return id;
+			}
+		}
+		return -1;
+	}
+
+public:
+
+	Bot(const BatchConfig& c, uint64_t seed) : config(c.bot), arena(c.arena), rng(mixSeed(seed) | 1), z(c.bot.hoverHeight) {}
+
+	void step(GameInstance& game, double time, double dt) {
+		switch (phase) {
+		case BOT_IDLE:
+			// a hamster that went away before the decision is forgotten
+			if (target >= 0 && !isVisible(game, target)) {
+				target = -1;
+			}
+			if (target < 0) {
+				int count = game.getNumHamsters();
+				int first = (int)(random() * count);
+				for (int k = 0; k < count && target < 0; k++) {
+					if (isVisible(game, (first + k) % count)) {
+						target = (first + k) % count;
+						decideTime = time + fmax(0.0, config.reactionTime + config.reactionJitter * gaussian());
+					}
+				}
+			}
+			if (target >= 0 && time >= decideTime) {
+				game.getPosition(target, aimX, aimY);
+				aimX += config.aimError * gaussian();
+				aimY += config.aimError * gaussian();
+				phase = BOT_AIM;
+			}
+			break;
+
+		case BOT_AIM: {
+			double dx = aimX - x;
+			double dy = aimY - y;
+			double distance = sqrt(dx * dx + dy * dy);
+			double step = config.moveSpeed * dt;
+			if (distance <= step) {
+				x = aimX;
+				y = aimY;
+				phase = BOT_STRIKE;
+			}
+			else {
+				x += dx * step / distance;
+				y += dy * step / distance;
+			}
+			break;
+		}
+
+		case BOT_STRIKE: {
+			z -= config.strikeSpeed * dt;
+			bool fast = config.strikeSpeed >= arena.minStrikeSpeed;
+			int hit = findContact(game, time);
+			if (hit >= 0) {
+				if (fast) {
+					game.strikeHamster(hit);
+				}
+				phase = BOT_LIFT;
+			}
+			else if (z - arena.headRadius <= arena.boardHeight) {
+				if (fast) {
+					game.strikeBoard();
+				}
+				phase = BOT_LIFT;
+			}
+			if (phase == BOT_LIFT) {
+				target = -1;
+			}
+			break;
+		}
+
+		case BOT_LIFT:
+			z += config.liftSpeed * dt;
+			if (config.liftSpeed >= arena.minLiftSpeed) {
+				game.liftHammer();
+			}
+			if (z >= config.hoverHeight) {
+				z = config.hoverHeight;
+				phase = BOT_IDLE;
+			}
+			break;
+		}
+	}
+};
+
+SessionStats simulateSession(const BatchConfig& config, uint64_t seed) {
+	GameInstance game(config.game, mixSeed(seed));
+	Bot bot(config, ~seed);
+
+	SessionStats stats;
+	stats.ticks = (long long)(config.duration / config.tickPeriod);
+
+	game.start(0.0);
+	for (long long t = 1; t <= stats.ticks; t++) {
+		double time = t * config.tickPeriod;
+		game.advance(time);
+		bot.step(game, time, config.tickPeriod);
+	}
+
+	stats.hits = game.getHits();
+	stats.misses = game.getMisses();
+	stats.popups = game.getPopups();
+	stats.escapes = game.getEscapes();
+	stats.hitLatency = game.getHitLatency();
+	return stats;
+}
+
+void runBatch(const BatchConfig& config, ostream& out) {
+	WorkStealingPool pool(config.threads);
+	vector<SessionStats> results(config.instances);
+
+	out << "batch - " << config.instances << " games of " << config.duration << " s on "
+		<< pool.getNumThreads() << " threads" << endl;
+
+	auto start = chrono::steady_clock::now();
+	pool.run(config.instances, [&](int k, int) {
+		results[k] = simulateSession(config, config.seed + (uint64_t)k * 0x9e3779b97f4a7c15ULL);
+	});
+	double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	double hits = 0.0, hits2 = 0.0, misses = 0.0, misses2 = 0.0;
+	double popups = 0.0, escapes = 0.0, latency = 0.0, ticks = 0.0;
+	for (const SessionStats& s : results) {
+		hits += s.hits;
+		hits2 += (double)s.hits * s.hits;
+		misses += s.misses;
+		misses2 += (double)s.misses * s.misses;
+		popups += s.popups;
+		escapes += s.escapes;
+		latency += s.hitLatency;
+		ticks += (double)s.ticks;
+	}
+
+	double n = fmax(1.0, (double)config.instances);
+	double hitsMean = hits / n;
+	double missesMean = misses / n;
+	out << "batch - hits per game " << hitsMean << " (sd " << sqrt(fmax(0.0, hits2 / n - hitsMean * hitsMean))
+		<< "), misses per game " << missesMean << " (sd " << sqrt(fmax(0.0, misses2 / n - missesMean * missesMean)) << ")" << endl;
+	out << "batch - " << (popups > 0.0 ? 100.0 * hits / popups : 0.0) << "% of hamsters hit, "
+		<< (popups > 0.0 ? 100.0 * escapes / popups : 0.0) << "% escaped, "
+		<< (hits > 0.0 ? 1000.0 * latency / hits : 0.0) << " ms from rising to hit" << endl;
+	out << "batch - " << wall << " s wall, " << config.instances / wall << " games/s, "
+		<< ticks / wall / 1e6 << " M ticks/s, " << ticks * config.tickPeriod / wall << "x real time" << endl;
+	for (int w = 0; w < pool.getNumThreads(); w++) {
+		out << "batch - thread " << w << ": " << pool.getNumJobs(w) << " games, "
+			<< pool.getNumSteals(w) << " steals" << endl;
+	}
+}
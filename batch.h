@@ -0,0 +1,110 @@
+#ifndef batch_h
+#define batch_h
+
+#include <stdio.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include "game.h"
+
+using namespace std;
+
+// Runs a number of independent jobs on a fixed set of threads. Jobs are dealt
+// out evenly as ranges, each worker takes jobs from the front of its own range
+// and once it is empty steals the back half of the range of another worker.
+class WorkStealingPool {
+	// one range per worker, padded so workers never share a cache line
+	struct alignas(64) Worker {
+		mutex lock;
+		int begin = 0;
+		int end = 0;
+		long long jobs = 0;
+		long long steals = 0;
+	};
+
+	int numThreads;
+	vector<Worker> workers;
+
+	bool next(int worker, int& job);
+	bool steal(int worker);
+
+public:
+
+	// 0 threads uses every hardware thread
+	WorkStealingPool(int threads = 0);
+
+	// Calls job(index, worker) once for every index in [0, jobs) and returns
+	// when all are done, the calling thread is worker 0
+	void run(int jobs, const function<void(int, int)>& job);
+
+	int getNumThreads() const;
+	// Jobs run and ranges stolen by a worker in the last run
+	long long getNumJobs(int worker) const;
+	long long getNumSteals(int worker) const;
+};
+
+// Scripted player of a headless game. It waits a reaction time after a
+// hamster shows up, moves the hammer over it with some aiming error and
+// strikes down, then lifts the hammer back to its hover height.
+struct BotConfig {
+	// reaction time after a hamster starts rising, mean and deviation [s]
+	double reactionTime = 0.3;
+	double reactionJitter = 0.08;
+	// deviation of the aimed point from the hamster center [units]
+	double aimError = 0.12;
+	// hammer speeds across the board, down when striking and up [units/s]
+	double moveSpeed = 5.0;
+	double strikeSpeed = 8.0;
+	double liftSpeed = 4.0;
+	// height of the hammer head between strikes [units]
+	double hoverHeight = 0.4;
+};
+
+// Contact model of the headless game
+struct ArenaConfig {
+	// radius of the hammer head and of a hamster [units]
+	double headRadius = 0.2;
+	double hamsterRadius = 0.25;
+	// height of the board surface, hamsters below it cannot be hit [units]
+	double boardHeight = -0.45;
+	// slowest downward speed that counts as a strike, and upward speed that
+	// counts as lifting the hammer [units/s]
+	double minStrikeSpeed = 3.0;
+	double minLiftSpeed = 2.0;
+};
+
+struct BatchConfig {
+	int instances = 1000;
+	// simulated length of every game and its logic tick [s]
+	double duration = 60.0;
+	double tickPeriod = 0.001;
+	// instance k is seeded from seed and k, so runs repeat exactly
+	uint64_t seed = 1;
+	int threads = 0;
+
+	GameConfig game;
+	BotConfig bot;
+	ArenaConfig arena;
+};
+
+// Final score of one headless game
+struct SessionStats {
+	int hits = 0;
+	int misses = 0;
+	int popups = 0;
+	int escapes = 0;
+	double hitLatency = 0.0;
+	long long ticks = 0;
+};
+
+// Plays one headless game of a bot to the end
+SessionStats simulateSession(const BatchConfig& config, uint64_t seed);
+
+// Plays all instances of a batch across the pool and logs the aggregate
+// statistics and throughput
+void runBatch(const BatchConfig& config, ostream& out);
+
+#endif
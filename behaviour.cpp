@@ -0,0 +1,188 @@
+#include "behaviour.h"
+
+FramePool::FramePool(size_t size, int blocks) {
+	// blocks keep the alignment of any frame
+	size_t align = alignof(max_align_t);
+	blockSize = (size + align - 1) / align * align;
+	memory.resize(blockSize * blocks + align);
+
+	unsigned char* base = memory.data();
+	base += (align - (size_t)base % align) % align;
+	for (int b = blocks - 1; b >= 0; b--) {
+		void* block = base + b * blockSize;
+		*(void**)block = freeList;
+		freeList = block;
+	}
+}
+
+void* FramePool::allocate(size_t size) {
+	if (size > blockSize || freeList == NULL) {
+		return NULL;
+	}
+	void* block = freeList;
+	freeList = *(void**)block;
+	used++;
+	return block;
+}
+
+void FramePool::deallocate(void* block) {
+	*(void**)block = freeList;
+	freeList = block;
+	used--;
+}
+
+size_t FramePool::getBlockSize() const {
+	return blockSize;
+}
+
+int FramePool::getNumUsed() const {
+	return used;
+}
+
+//------------------------------------------------------------------------------
+
+void Behaviour::promise_type::operator delete(void* frame, size_t) noexcept {
+	void* block = (unsigned char*)frame - FRAME_HEADER;
+	(*(FramePool**)block)->deallocate(block);
+}
+
+Behaviour& Behaviour::operator=(Behaviour&& other) noexcept {
+	if (this != &other) {
+		if (handle) {
+			handle.destroy();
+		}
+		handle = other.handle;
+		other.handle = nullptr;
+	}
+	return *this;
+}
+
+Behaviour::~Behaviour() {
+	if (handle) {
+		handle.destroy();
+	}
+}
+
+//------------------------------------------------------------------------------
+
+BehaviourScheduler::BehaviourScheduler(int capacity, size_t frameSize, double tickResolution) :
+	pool(frameSize + Behaviour::promise_type::FRAME_HEADER, capacity), timers(tickResolution, capacity), slots(capacity) {
+	for (int s = capacity - 1; s >= 0; s--) {
+		slots[s].next = freeSlots;
+		freeSlots = s;
+	}
+	due.reserve(capacity);
+}
+
+BehaviourScheduler::~BehaviourScheduler() {
+	clear(now);
+}
+
+int BehaviourScheduler::spawn(Behaviour behaviour) {
+	if (!behaviour.isValid() || freeSlots < 0) {
+		return -1;
+	}
+	int slot = freeSlots;
+	freeSlots = slots[slot].next;
+	active++;
+
+	Slot& s = slots[slot];
+	s.handle = behaviour.handle;
+	s.handle.promise().slot = slot;
+	s.timer = -1;
+	s.interruptible = false;
+	s.interrupted = false;
+	behaviour.handle = nullptr;
+
+	resume(slot);
+	return slot;
+}
+
+void BehaviourScheduler::advance(double time) {
+	now = time;
+	due.clear();
+	timers.advance(time, due);
+	for (int slot : due) {
+		// skips behaviours destroyed by one resumed before them
+		if (slots[slot].handle) {
+			slots[slot].timer = -1;
+			resume(slot);
+		}
+	}
+}
+
+bool BehaviourScheduler::signal(int slot) {
+	if (slot < 0 || slot >= (int)slots.size() || !slots[slot].handle || !slots[slot].interruptible) {
+		return false;
+	}
+	Slot& s = slots[slot];
+	timers.cancel(s.timer);
+	s.timer = -1;
+	s.interrupted = true;
+	resume(slot);
+	return true;
+}
+
+void BehaviourScheduler::clear(double time) {
+	for (int slot = 0; slot < (int)slots.size(); slot++) {
+		if (slots[slot].handle) {
+			release(slot);
+		}
+	}
+	timers.reset(time);
+	now = time;
+}
+
+void BehaviourScheduler::resume(int slot) {
+	slots[slot].interruptible = false;
+	slots[slot].handle.resume();
+	// a finished behaviour gives its slot and frame back
+	if (slots[slot].handle && slots[slot].handle.done()) {
+		release(slot);
+	}
+}
+
+void BehaviourScheduler::release(int slot) {
+	Slot& s = slots[slot];
+	timers.cancel(s.timer);
+	s.timer = -1;
+	s.handle.destroy();
+	s.handle = nullptr;
+	s.next = freeSlots;
+	freeSlots = slot;
+	active--;
+}
+
+BehaviourScheduler::Wait BehaviourScheduler::sleep(double duration) {
+	return Wait{ this, duration, false };
+}
+
+BehaviourScheduler::Wait BehaviourScheduler::waitEvent(double duration) {
+	return Wait{ this, duration, true };
+}
+
+void BehaviourScheduler::Wait::await_suspend(coroutine_handle<Behaviour::promise_type> h) noexcept {
+	slot = h.promise().slot;
+	Slot& s = scheduler->slots[slot];
+	s.interruptible = interruptible;
+	s.interrupted = false;
+	s.timer = scheduler->timers.schedule(scheduler->now + duration, slot);
+}
+
+bool BehaviourScheduler::Wait::await_resume() noexcept {
+	bool interrupted = scheduler->slots[slot].interrupted;
+	scheduler->slots[slot].interrupted = false;
+	return interrupted;
+}
+
+double BehaviourScheduler::getTime() const {
+	return now;
+}
+
+int BehaviourScheduler::getNumActive() const {
+	return active;
+}
+
+const FramePool& BehaviourScheduler::getPool() const {
+	return pool;
+}
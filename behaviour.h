@@ -0,0 +1,163 @@
+#ifndef behaviour_h
+#define behaviour_h
+
+#include <stdio.h>
+#include <coroutine>
+#include <cstddef>
+#include <vector>
+#include "timer_wheel.h"
+
+using namespace std;
+
+// Game behaviours written as C++20 coroutines. A behaviour runs until it
+// awaits time or an event and is resumed by the game logic tick when that
+// comes due. Frames come from a preallocated pool, so spawning and running
+// behaviours never touches the heap.
+
+class BehaviourScheduler;
+
+// Fixed size blocks carved from one allocation, unused blocks are chained
+// in a free list
+class FramePool {
+	size_t blockSize;
+	vector<unsigned char> memory;
+	void* freeList = NULL;
+	int used = 0;
+
+public:
+
+	FramePool(size_t blockSize, int blocks);
+
+	// Returns a block for size bytes, NULL when too large or none is left
+	void* allocate(size_t size);
+	void deallocate(void* block);
+
+	size_t getBlockSize() const;
+	int getNumUsed() const;
+};
+
+// Handle to a behaviour coroutine, owned by the scheduler once spawned
+class Behaviour {
+public:
+
+	struct promise_type {
+		// room in front of a frame for its pool, kept aligned for the frame
+		static const size_t FRAME_HEADER = alignof(max_align_t);
+
+		BehaviourScheduler* scheduler;
+		int slot = -1;
+
+		// the first parameter of every behaviour is its scheduler, which
+		// provides the pool its frame comes from
+		template <typename... Args>
+		promise_type(BehaviourScheduler& s, Args&&...) : scheduler(&s) {}
+
+		template <typename... Args>
+		static void* operator new(size_t size, BehaviourScheduler& s, Args&&...) noexcept;
+		static void operator delete(void* frame, size_t size) noexcept;
+
+		// a behaviour whose frame does not fit in the pool is not created
+		static Behaviour get_return_object_on_allocation_failure() noexcept { return Behaviour(); }
+
+		Behaviour get_return_object() noexcept {
+			return Behaviour(coroutine_handle<promise_type>::from_promise(*this));
+		}
+		suspend_always initial_suspend() noexcept { return {}; }
+		suspend_always final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept {}
+	};
+
+	Behaviour() {}
+	explicit Behaviour(coroutine_handle<promise_type> h) : handle(h) {}
+	Behaviour(Behaviour&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+	Behaviour& operator=(Behaviour&& other) noexcept;
+	Behaviour(const Behaviour&) = delete;
+	Behaviour& operator=(const Behaviour&) = delete;
+	~Behaviour();
+
+	bool isValid() const { return (bool)handle; }
+
+private:
+
+	friend class BehaviourScheduler;
+	coroutine_handle<promise_type> handle;
+};
+
+// Runs spawned behaviours from the game logic tick. Sleeps are timers in a
+// timer wheel, so a tick only resumes the behaviours that come due.
+class BehaviourScheduler {
+	struct Slot {
+		coroutine_handle<Behaviour::promise_type> handle;
+		int timer = -1;
+		// an event ends the current wait
+		bool interruptible = false;
+		bool interrupted = false;
+		int next = -1;
+	};
+
+	FramePool pool;
+	TimerWheel timers;
+	vector<Slot> slots;
+	int freeSlots = -1;
+	int active = 0;
+	double now = 0.0;
+	vector<int> due;
+
+	void resume(int slot);
+	void release(int slot);
+
+	// Suspends the awaiting behaviour until a duration has passed, or until an
+	// event when interruptible. Resumes with true if an event ended the wait.
+	struct Wait {
+		BehaviourScheduler* scheduler;
+		double duration;
+		bool interruptible;
+		int slot = -1;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(coroutine_handle<Behaviour::promise_type> h) noexcept;
+		bool await_resume() noexcept;
+	};
+
+public:
+
+	friend struct Behaviour::promise_type;
+
+	// capacity behaviours with frames of up to frameSize bytes
+	BehaviourScheduler(int capacity, size_t frameSize = 512, double tickResolution = 0.001);
+	~BehaviourScheduler();
+
+	// Takes a behaviour and runs it up to its first wait, returns its slot or
+	// -1 if it was not created or no slot is free
+	int spawn(Behaviour behaviour);
+	// Resumes the behaviours whose wait ends by the given time
+	void advance(double time);
+	// Ends the interruptible wait of a behaviour at once, returns false if
+	// it was not waiting for an event
+	bool signal(int slot);
+	// Destroys all behaviours and restarts the clock at the given time
+	void clear(double time);
+
+	// co_await sleep(d) waits for d seconds, events are ignored
+	Wait sleep(double duration);
+	// co_await waitEvent(d) waits for d seconds or an event, true on an event
+	Wait waitEvent(double duration);
+
+	double getTime() const;
+	int getNumActive() const;
+	const FramePool& getPool() const;
+};
+
+template <typename... Args>
+void* Behaviour::promise_type::operator new(size_t size, BehaviourScheduler& s, Args&&...) noexcept {
+	// the pool is recorded in front of the frame for operator delete
+	void* block = s.pool.allocate(size + FRAME_HEADER);
+	if (block == NULL) {
+		return NULL;
+	}
+	*(FramePool**)block = &s.pool;
+	return (unsigned char*)block + FRAME_HEADER;
+}
+
+#endif
@@ -0,0 +1,254 @@
+#ifndef bench_h
+#define bench_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "realtime.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+// Small harness shared by the benchmarks: times a call until enough samples
+// are collected, counts heap allocations through the allocation guard of
+// realtime.cpp and reads the hardware cache miss counter where available.
+//------------------------------------------------------------------------------
+
+struct BenchResult {
+	string name;
+	vector<pair<string, long long>> params;
+	long long calls;
+	double nsPerOp;
+	double allocationsPerCall;
+	// negative when the counter is not available
+	double cacheMissesPerOp;
+};
+
+// Hardware cache miss counter of the calling thread
+class CacheMissCounter {
+	int fd = -1;
+
+public:
+
+	CacheMissCounter() {
+#if defined(__linux__)
+		perf_event_attr attr = perf_event_attr();
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.size = sizeof(attr);
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+	}
+
+	~CacheMissCounter() {
+#if defined(__linux__)
+		if (fd >= 0) {
+			close(fd);
+		}
+#endif
+	}
+
+	bool isAvailable() const {
+		return fd >= 0;
+	}
+
+	void start() {
+#if defined(__linux__)
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	long long stop() {
+		long long count = -1;
+#if defined(__linux__)
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+				count = -1;
+			}
+		}
+#endif
+		return count;
+	}
+};
+
+class BenchSuite {
+	vector<BenchResult> results;
+	string filter;
+	double minTime = 0.2;
+	CacheMissCounter cacheMisses;
+
+public:
+
+	BenchSuite(int argc, char* argv[], string& jsonPath) {
+		for (int i = 1; i < argc; i++) {
+			string arg = argv[i];
+			if (arg == "--json" && i + 1 < argc) {
+				jsonPath = argv[++i];
+			}
+			else if (arg == "--filter" && i + 1 < argc) {
+				filter = argv[++i];
+			}
+			else if (arg == "--min-time" && i + 1 < argc) {
+				minTime = atof(argv[++i]);
+			}
+		}
+	}
+
+	bool isSelected(const string& name) const {
+		return filter.empty() || name.find(filter) != string::npos;
+	}
+
+	// Times call() which performs opsPerCall operations, setup is not measured
+	template <class F>
+	void run(const string& name, const vector<pair<string, long long>>& params, long long opsPerCall, F call) {
+		if (!isSelected(name)) {
+			return;
+		}
+
+		// Warm up caches and any lazily grown buffer
+		call();
+
+		long long calls = 0;
+		long long allocations = getGuardedAllocations();
+		long long misses = 0;
+		bool missesValid = cacheMisses.isAvailable();
+		chrono::steady_clock::duration elapsed(0);
+
+		while (chrono::duration<double>(elapsed).count() < minTime) {
+			setAllocationGuard(true);
+			cacheMisses.start();
+			auto t0 = chrono::steady_clock::now();
+			call();
+			auto t1 = chrono::steady_clock::now();
+			long long m = cacheMisses.stop();
+			setAllocationGuard(false);
+
+			elapsed += t1 - t0;
+			misses += m;
+			missesValid = missesValid && m >= 0;
+			calls++;
+		}
+		allocations = getGuardedAllocations() - allocations;
+
+		BenchResult r;
+		r.name = name;
+		r.params = params;
+		r.calls = calls;
+		double ops = (double)calls * opsPerCall;
+		r.nsPerOp = chrono::duration<double, nano>(elapsed).count() / ops;
+		r.allocationsPerCall = (double)allocations / calls;
+		r.cacheMissesPerOp = missesValid ? misses / ops : -1.0;
+		results.push_back(r);
+
+		cout << name;
+		for (const pair<string, long long>& p : params) {
+			cout << " " << p.first << "=" << p.second;
+		}
+		cout << "  " << r.nsPerOp << " ns/op  " << r.allocationsPerCall << " allocs/call";
+		if (r.cacheMissesPerOp >= 0.0) {
+			cout << "  " << r.cacheMissesPerOp << " cache misses/op";
+		}
+		cout << endl;
+	}
+
+	// Writes all results as JSON so releases can be compared by a script
+	bool writeJson(const string& path, const string& suite) const {
+		ofstream out(path.c_str());
+		if (!out) {
+			return false;
+		}
+		out << "{\n  \"suite\": \"" << suite << "\",\n  \"results\": [\n";
+		for (size_t i = 0; i < results.size(); i++) {
+			const BenchResult& r = results[i];
+			out << "    {\"name\": \"" << r.name << "\", \"params\": {";
+			for (size_t k = 0; k < r.params.size(); k++) {
+				out << (k > 0 ? ", " : "") << "\"" << r.params[k].first << "\": " << r.params[k].second;
+			}
+			out << "}, \"calls\": " << r.calls
+				<< ", \"ns_per_op\": " << r.nsPerOp
+				<< ", \"allocations_per_call\": " << r.allocationsPerCall
+				<< ", \"cache_misses_per_op\": ";
+			if (r.cacheMissesPerOp >= 0.0) {
+				out << r.cacheMissesPerOp;
+			}
+			else {
+				out << "null";
+			}
+			out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		out << "  ]\n}\n";
+		return out.good();
+	}
+};
+
+//------------------------------------------------------------------------------
+// Mesh loading
+//------------------------------------------------------------------------------
+
+struct Triangle {
+	float v[3][3];
+};
+
+// Reads the positions of an OBJ file, faces are fanned into triangles
+inline bool loadObj(const string& path, vector<Triangle>& triangles) {
+	ifstream file(path.c_str());
+	if (!file) {
+		return false;
+	}
+	vector<float> positions;
+	string line;
+	while (getline(file, line)) {
+		istringstream in(line);
+		string tag;
+		in >> tag;
+		if (tag == "v") {
+			float x, y, z;
+			in >> x >> y >> z;
+			positions.push_back(x);
+			positions.push_back(y);
+			positions.push_back(z);
+		}
+		else if (tag == "f") {
+			vector<int> face;
+			string corner;
+			while (in >> corner) {
+				face.push_back(atoi(corner.c_str()) - 1);
+			}
+			for (size_t k = 2; k < face.size(); k++) {
+				Triangle t;
+				int ids[3] = { face[0], face[k - 1], face[k] };
+				for (int v = 0; v < 3; v++) {
+					for (int c = 0; c < 3; c++) {
+						t.v[v][c] = positions[3 * ids[v] + c];
+					}
+				}
+				triangles.push_back(t);
+			}
+		}
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,264 @@
+//==============================================================================
+/*
+	Query benchmark for the board collision backends
+
+	Loads game_world.obj, builds the flat BVH and a pointer based AABB tree
+	laid out like the CHAI3D one (one node allocation per box, one triangle
+	per leaf) and measures the latency of tool sphere proximity queries. The
+	baked distance field is timed on the same tool positions.
+
+	Build from the repository root:
+		g++ -O2 -std=c++11 -I. -Ibenchmarks benchmarks/bvh_benchmark.cpp bvh.cpp sdf.cpp realtime.cpp -o bvh_benchmark
+	Run:
+		./bvh_benchmark [resources/models/game_world.obj] [queries]
+*/
+//==============================================================================
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <float.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "bvh.h"
+#include "sdf.h"
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+// Pointer based baseline
+//------------------------------------------------------------------------------
+
+struct PointerNode {
+	float min[3];
+	float max[3];
+	PointerNode* left = NULL;
+	PointerNode* right = NULL;
+	const Triangle* triangle = NULL;
+
+	~PointerNode() {
+		delete left;
+		delete right;
+	}
+};
+
+static float centroid(const Triangle& t, int axis) {
+	return (t.v[0][axis] + t.v[1][axis] + t.v[2][axis]) / 3.0f;
+}
+
+PointerNode* buildPointerTree(vector<const Triangle*>& items, int first, int count) {
+	PointerNode* node = new PointerNode();
+	for (int k = 0; k < 3; k++) {
+		node->min[k] = FLT_MAX;
+		node->max[k] = -FLT_MAX;
+	}
+	for (int i = first; i < first + count; i++) {
+		for (int v = 0; v < 3; v++) {
+			for (int k = 0; k < 3; k++) {
+				node->min[k] = min(node->min[k], items[i]->v[v][k]);
+				node->max[k] = max(node->max[k], items[i]->v[v][k]);
+			}
+		}
+	}
+	if (count == 1) {
+		node->triangle = items[first];
+		return node;
+	}
+	int axis = 0;
+	for (int k = 1; k < 3; k++) {
+		if (node->max[k] - node->min[k] > node->max[axis] - node->min[axis]) {
+			axis = k;
+		}
+	}
+	int mid = first + count / 2;
+	nth_element(items.begin() + first, items.begin() + mid, items.begin() + first + count,
+		[axis](const Triangle* a, const Triangle* b) { return centroid(*a, axis) < centroid(*b, axis); });
+	node->left = buildPointerTree(items, first, mid - first);
+	node->right = buildPointerTree(items, mid, first + count - mid);
+	return node;
+}
+
+static float boxDistance2(const float lo[3], const float hi[3], const float p[3]) {
+	float d2 = 0.0f;
+	for (int k = 0; k < 3; k++) {
+		float d = max(lo[k] - p[k], 0.0f) + max(p[k] - hi[k], 0.0f);
+		d2 += d * d;
+	}
+	return d2;
+}
+
+static float triangleDistance2(const Triangle& t, const float p[3]) {
+	// Same Voronoi region test as FlatBVH::closestPointOnTriangle
+	float ab[3], ac[3], ap[3], bp[3], cp[3], q[3];
+	for (int k = 0; k < 3; k++) {
+		ab[k] = t.v[1][k] - t.v[0][k];
+		ac[k] = t.v[2][k] - t.v[0][k];
+		ap[k] = p[k] - t.v[0][k];
+		bp[k] = p[k] - t.v[1][k];
+		cp[k] = p[k] - t.v[2][k];
+	}
+	auto dot = [](const float* a, const float* b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; };
+	float d1 = dot(ab, ap), d2 = dot(ac, ap), d3 = dot(ab, bp), d4 = dot(ac, bp);
+	float d5 = dot(ab, cp), d6 = dot(ac, cp);
+	float vc = d1 * d4 - d3 * d2, vb = d5 * d2 - d1 * d6, va = d3 * d6 - d5 * d4;
+	if (d1 <= 0 && d2 <= 0) for (int k = 0; k < 3; k++) q[k] = t.v[0][k];
+	else if (d3 >= 0 && d4 <= d3) for (int k = 0; k < 3; k++) q[k] = t.v[1][k];
+	else if (vc <= 0 && d1 >= 0 && d3 <= 0) for (int k = 0; k < 3; k++) q[k] = t.v[0][k] + d1 / (d1 - d3) * ab[k];
+	else if (d6 >= 0 && d5 <= d6) for (int k = 0; k < 3; k++) q[k] = t.v[2][k];
+	else if (vb <= 0 && d2 >= 0 && d6 <= 0) for (int k = 0; k < 3; k++) q[k] = t.v[0][k] + d2 / (d2 - d6) * ac[k];
+	else if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) for (int k = 0; k < 3; k++) q[k] = t.v[1][k] + (d4 - d3) / ((d4 - d3) + (d5 - d6)) * (t.v[2][k] - t.v[1][k]);
+	else {
+		float s = va + vb + vc;
+		float v = s != 0 ? vb / s : 0, w = s != 0 ? vc / s : 0;
+		for (int k = 0; k < 3; k++) q[k] = t.v[0][k] + ab[k] * v + ac[k] * w;
+	}
+	float d[3] = { p[0] - q[0], p[1] - q[1], p[2] - q[2] };
+	return dot(d, d);
+}
+
+static void pointerQuery(const PointerNode* node, const float p[3], float& best) {
+	if (boxDistance2(node->min, node->max, p) > best) {
+		return;
+	}
+	if (node->triangle != NULL) {
+		best = min(best, triangleDistance2(*node->triangle, p));
+		return;
+	}
+	pointerQuery(node->left, p, best);
+	pointerQuery(node->right, p, best);
+}
+
+//------------------------------------------------------------------------------
+// Measurement
+//------------------------------------------------------------------------------
+
+struct Stats {
+	double mean;
+	double p50;
+	double p99;
+	double max;
+};
+
+Stats summarize(vector<double>& samples) {
+	Stats s;
+	sort(samples.begin(), samples.end());
+	double sum = 0.0;
+	for (double x : samples) {
+		sum += x;
+	}
+	s.mean = sum / samples.size();
+	s.p50 = samples[samples.size() / 2];
+	s.p99 = samples[(size_t)(samples.size() * 0.99)];
+	s.max = samples.back();
+	return s;
+}
+
+void printStats(const string& name, const Stats& s) {
+	cout << name << "  mean " << s.mean << " ns  p50 " << s.p50 << " ns  p99 " << s.p99
+		<< " ns  max " << s.max << " ns" << endl;
+}
+
+int main(int argc, char* argv[]) {
+	string path = argc > 1 ? argv[1] : "resources/models/game_world.obj";
+	int queries = argc > 2 ? atoi(argv[2]) : 200000;
+	const float radius = 0.2f;
+
+	vector<Triangle> triangles;
+	if (!loadObj(path, triangles) || triangles.empty()) {
+		cout << "failed to load " << path << endl;
+		return 1;
+	}
+
+	FlatBVH bvh;
+	for (const Triangle& t : triangles) {
+		bvh.addTriangle(t.v[0], t.v[1], t.v[2]);
+	}
+	bvh.build();
+
+	vector<const Triangle*> items;
+	for (const Triangle& t : triangles) {
+		items.push_back(&t);
+	}
+	PointerNode* root = buildPointerTree(items, 0, (int)items.size());
+
+	cout << triangles.size() << " triangles, " << bvh.getNumNodes() << " flat nodes" << endl;
+
+	// Tool positions: half close to the surface, half anywhere in the bounds
+	float lo[3], hi[3];
+	bvh.getBounds(lo, hi);
+	srand(1);
+	auto uniform = []() { return rand() / (RAND_MAX + 1.0f); };
+	vector<float> points(3 * queries);
+	for (int i = 0; i < queries; i++) {
+		float* p = &points[3 * i];
+		if (i % 2 == 0) {
+			const Triangle& t = triangles[rand() % triangles.size()];
+			float u = uniform(), v = uniform();
+			if (u + v > 1.0f) {
+				u = 1.0f - u;
+				v = 1.0f - v;
+			}
+			for (int k = 0; k < 3; k++) {
+				p[k] = t.v[0][k] + u * (t.v[1][k] - t.v[0][k]) + v * (t.v[2][k] - t.v[0][k])
+					+ (uniform() - 0.5f) * 2.0f * radius;
+			}
+		}
+		else {
+			for (int k = 0; k < 3; k++) {
+				p[k] = lo[k] + uniform() * (hi[k] - lo[k]);
+			}
+		}
+	}
+
+	vector<double> flatTimes(queries), pointerTimes(queries);
+	int contacts = 0;
+	int mismatches = 0;
+	for (int i = 0; i < queries; i++) {
+		const float* p = &points[3 * i];
+
+		auto t0 = chrono::steady_clock::now();
+		BVHHit hit;
+		bool found = bvh.closestPoint(p, radius, hit);
+		auto t1 = chrono::steady_clock::now();
+		float best = radius * radius;
+		pointerQuery(root, p, best);
+		auto t2 = chrono::steady_clock::now();
+
+		flatTimes[i] = (double)chrono::duration_cast<chrono::nanoseconds>(t1 - t0).count();
+		pointerTimes[i] = (double)chrono::duration_cast<chrono::nanoseconds>(t2 - t1).count();
+
+		bool expected = best < radius * radius;
+		if (found != expected || (found && fabs(fabs(hit.distance) - sqrtf(best)) > 1e-4f)) {
+			mismatches++;
+		}
+		contacts += found ? 1 : 0;
+	}
+
+	// Distance field baked like the game does it, band of twice the radius
+	DistanceField field;
+	auto b0 = chrono::steady_clock::now();
+	field.bake(bvh, 0.05f, 2.0f * radius);
+	auto b1 = chrono::steady_clock::now();
+	vector<double> fieldTimes(queries);
+	for (int i = 0; i < queries; i++) {
+		float distance, gradient[3];
+		auto t0 = chrono::steady_clock::now();
+		field.query(&points[3 * i], distance, gradient);
+		auto t1 = chrono::steady_clock::now();
+		fieldTimes[i] = (double)chrono::duration_cast<chrono::nanoseconds>(t1 - t0).count();
+	}
+
+	cout << queries << " sphere queries (radius " << radius << "), " << contacts << " in contact, "
+		<< mismatches << " mismatches" << endl;
+	cout << "distance field: " << field.getNumBricks() << " bricks, " << field.getMemorySize() / 1024
+		<< " KiB, baked in " << chrono::duration<double>(b1 - b0).count() << " s" << endl;
+	printStats("flat bvh   ", summarize(flatTimes));
+	printStats("pointer aabb", summarize(pointerTimes));
+	printStats("sdf lookup  ", summarize(fieldTimes));
+
+	delete root;
+	return mismatches == 0 ? 0 : 1;
+}
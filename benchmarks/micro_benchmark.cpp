@@ -0,0 +1,431 @@
+//==============================================================================
+/*
+	Microbenchmarks of the physics and game hot paths
+
+	Measures Sphere::updateSphere, Sphere::calculateForces,
+	Spring::calculateForces, the particle system step, the spatial hash, the
+	hamster update (the game instance against the former per-tick random
+	sampling) and the board collision queries along tool trajectories over
+	the shipped meshes.
+	Reports ns per operation, heap allocations per call and cache misses per
+	operation, and writes the results as JSON for comparing releases.
+
+	Build from the repository root against CHAI3D:
+		g++ -O2 -std=c++20 -I. -Ibenchmarks -I<chai3d>/src -I<chai3d>/external/Eigen
+			benchmarks/micro_benchmark.cpp sphere.cpp spring.cpp spatial_hash.cpp
+			particle_system.cpp motion.cpp timer_wheel.cpp behaviour.cpp game.cpp bvh.cpp sdf.cpp point_shell.cpp realtime.cpp
+			-L<chai3d>/lib/release/lin-x86_64-cc -lchai3d -lGL -lpthread -o micro_benchmark
+	Run:
+		./micro_benchmark [--filter name] [--min-time seconds] [--json results.json]
+*/
+//==============================================================================
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "sphere.h"
+#include "spring.h"
+#include "spatial_hash.h"
+#include "particle_system.h"
+#include "motion.h"
+#include "game.h"
+#include "bvh.h"
+#include "sdf.h"
+#include "point_shell.h"
+
+using namespace std;
+
+static const int PARTICLE_COUNTS[] = { 10, 100, 1000, 10000, 100000 };
+static const int GRID_SIZES[] = { 3, 10, 32, 100 };
+
+static double uniform() {
+	return rand() / (RAND_MAX + 1.0);
+}
+
+// Random spheres spread over a square of side ~ sqrt(n) radii
+static vector<Sphere*> makeSpheres(int n, double radius) {
+	double side = sqrt((double)n) * 3.0 * radius;
+	vector<Sphere*> spheres;
+	for (int i = 0; i < n; i++) {
+		Sphere* s = new Sphere(cVector3d(uniform() * side, uniform() * side, uniform() * radius), radius);
+		s->velocity = cVector3d(uniform() - 0.5, uniform() - 0.5, 0.0);
+		spheres.push_back(s);
+	}
+	return spheres;
+}
+
+static void deleteSpheres(vector<Sphere*>& spheres) {
+	for (Sphere* s : spheres) {
+		delete s->point;
+		delete s;
+	}
+	spheres.clear();
+}
+
+// Tool path circling over a box and striking down into it
+static void toolTrajectory(const float lo[3], const float hi[3], int count, vector<float>& points) {
+	points.resize(3 * count);
+	for (int i = 0; i < count; i++) {
+		double t = (double)i / count;
+		points[3 * i] = (float)(0.5 * (lo[0] + hi[0]) + 0.4 * (hi[0] - lo[0]) * cos(2.0 * M_PI * t));
+		points[3 * i + 1] = (float)(0.5 * (lo[1] + hi[1]) + 0.4 * (hi[1] - lo[1]) * sin(2.0 * M_PI * t));
+		points[3 * i + 2] = (float)(lo[2] + (hi[2] - lo[2]) * fabs(sin(24.0 * M_PI * t)));
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void benchSpheres(BenchSuite& suite) {
+	for (int n : PARTICLE_COUNTS) {
+		vector<pair<string, long long>> params = { make_pair(string("n"), (long long)n) };
+		vector<Sphere*> spheres = makeSpheres(n, 0.01);
+
+		suite.run("sphere_update", params, n, [&]() {
+			for (Sphere* s : spheres) {
+				s->addForce(cVector3d(0.0, 0.0, 0.001));
+				s->updateSphere(0.001);
+			}
+		});
+
+		int tick = 0;
+		suite.run("sphere_cursor_forces", params, n, [&]() {
+			// Cursor sweeps across the particles so some calls make contact
+			cVector3d cursor(0.01 * (tick++ % 100), 0.02, 0.0);
+			for (Sphere* s : spheres) {
+				s->calculateForces(cursor, 0.05);
+			}
+			for (Sphere* s : spheres) {
+				s->updateSphere(0.0);
+			}
+		});
+
+		deleteSpheres(spheres);
+	}
+}
+
+void benchSprings(BenchSuite& suite) {
+	for (int n : PARTICLE_COUNTS) {
+		vector<pair<string, long long>> params = { make_pair(string("n"), (long long)n) };
+
+		// One chain of n spheres
+		vector<Sphere*> spheres;
+		vector<Spring*> springs;
+		for (int i = 0; i < n; i++) {
+			spheres.push_back(new Sphere(cVector3d(0.02 * i, 0.001 * (i % 2), 0.0), 0.01));
+			if (i > 0) {
+				springs.push_back(new Spring(spheres[i - 1], spheres[i], 0.019, 50.0, 0.01));
+			}
+		}
+		int count = (int)springs.size();
+
+		suite.run("spring_forces", params, cMax(count, 1), [&]() {
+			for (Spring* s : springs) {
+				s->calculateForces();
+			}
+			for (Sphere* s : spheres) {
+				s->updateSphere(0.001);
+			}
+		});
+
+		for (Spring* s : springs) {
+			delete s->line;
+			delete s;
+		}
+		deleteSpheres(spheres);
+	}
+}
+
+void benchParticleSystem(BenchSuite& suite) {
+	for (int n : PARTICLE_COUNTS) {
+		vector<pair<string, long long>> params = { make_pair(string("n"), (long long)n) };
+
+		// Bodies of five spheres on a grid, the cursor strikes across them
+		ParticleSystem system(0.05);
+		vector<Spring*> springs;
+		int bodies = cMax(n / 5, 1);
+		int side = (int)ceil(sqrt((double)bodies));
+		for (int b = 0; b < bodies; b++) {
+			Sphere* previous = NULL;
+			for (int k = 0; k < 5; k++) {
+				Sphere* s = new Sphere(cVector3d(0.2 * (b % side), 0.2 * (b / side) + 0.03 * k, 0.001 * (k % 2)), 0.01);
+				system.addSphere(s);
+				if (previous != NULL) {
+					springs.push_back(new Spring(previous, s, 0.03, 50.0, 0.01));
+					system.addSpring(springs.back());
+				}
+				previous = s;
+			}
+		}
+		system.buildIslands();
+		int spheres = system.getNumSpheres();
+
+		int tick = 0;
+		auto step = [&]() {
+			double t = 0.001 * tick++;
+			cVector3d cursor(0.2 * side * 0.5 * (1.0 + sin(t)), 0.2 * side * 0.5, 0.0);
+			system.step(0.001, cursor, 0.02);
+		};
+
+		system.wakeAll();
+		suite.run("particle_step_awake", params, spheres, [&]() {
+			system.wakeAll();
+			step();
+		});
+
+		// Let the bodies settle so only the struck islands stay awake
+		for (int i = 0; i < 2 * system.sleepSteps; i++) {
+			system.step(0.001, cVector3d(-10.0, -10.0, -10.0), 0.02);
+		}
+		suite.run("particle_step_sleeping", params, spheres, step);
+
+		for (Spring* s : springs) {
+			delete s->line;
+			delete s;
+		}
+		for (int i = 0; i < spheres; i++) {
+			delete system.getSphere(i)->point;
+			delete system.getSphere(i);
+		}
+	}
+}
+
+void benchSpatialHash(BenchSuite& suite) {
+	for (int n : PARTICLE_COUNTS) {
+		vector<pair<string, long long>> params = { make_pair(string("n"), (long long)n) };
+		vector<Sphere*> spheres = makeSpheres(n, 0.01);
+		SpatialHash hash(0.025, 2 * n);
+		for (Sphere* s : spheres) {
+			hash.add(s);
+		}
+
+		suite.run("spatial_hash_update", params, n, [&]() {
+			for (Sphere* s : spheres) {
+				s->updateSphere(0.001);
+			}
+			hash.update();
+		});
+
+		vector<pair<int, int>> pairs;
+		pairs.reserve(4 * n);
+		suite.run("spatial_hash_pairs", params, n, [&]() {
+			pairs.clear();
+			hash.findPairs(pairs);
+		});
+
+		deleteSpheres(spheres);
+	}
+}
+
+//------------------------------------------------------------------------------
+
+// Hamster update as it was before the timer wheel: every tick a number of
+// random cells roll rand() % 10000 against tiny thresholds and moving
+// hamsters step by a fixed height. The original visited 25 cells of the 3 x 3
+// board per tick, the same ratio is kept for larger boards.
+struct SamplingBoard {
+	int size;
+	int visits;
+	vector<int> state;
+	vector<double> height;
+
+	SamplingBoard(int grid) : size(grid * grid), visits(25 * grid * grid / 9), state(size, 0), height(size, -0.8) {}
+
+	void tick() {
+		for (int k = 0; k < visits; k++) {
+			int i = rand() % size;
+			if (state[i] == 0) {
+				if ((rand() % 10000) + 1 <= 2) {
+					state[i] = 1;
+				}
+			}
+			else if (state[i] == 1) {
+				if (height[i] < -0.199) {
+					height[i] += 0.001;
+				}
+				else {
+					state[i] = 2;
+				}
+			}
+			else if (state[i] == 2) {
+				if ((rand() % 10000) + 1 <= 4) {
+					state[i] = 4;
+				}
+			}
+			else if (height[i] > -0.8) {
+				height[i] -= state[i] == 3 ? 0.001 : 0.0015;
+			}
+			else if (state[i] == 3 || (rand() % 10000) + 1 <= 1) {
+				state[i] = 0;
+			}
+		}
+	}
+};
+
+void benchHamsters(BenchSuite& suite) {
+	for (int grid : GRID_SIZES) {
+		vector<pair<string, long long>> params = { make_pair(string("grid"), (long long)grid) };
+		SamplingBoard board(grid);
+		suite.run("hamster_sampling", params, 1, [&]() {
+			board.tick();
+		});
+	}
+
+	// the game logic tick of the haptic loop, with a strike every 50 ticks on
+	// the next risen hamster so hits and knock outs are part of the cost
+	for (int grid : GRID_SIZES) {
+		vector<pair<string, long long>> params = { make_pair(string("grid"), (long long)grid) };
+		GameConfig config;
+		config.grid = grid;
+		GameInstance game(config, 1);
+		game.start(0.0);
+		long long tick = 0;
+		int next = 0;
+		suite.run("hamster_game", params, 1, [&]() {
+			double time = 0.001 * ++tick;
+			game.advance(time);
+			if (tick % 50 == 0) {
+				for (int k = 0; k < game.getNumHamsters(); k++) {
+					int id = (next + k) % game.getNumHamsters();
+					if (game.getState(id) == 1 || game.getState(id) == 2) {
+						game.strikeHamster(id);
+						game.liftHammer();
+						next = id + 1;
+						break;
+					}
+				}
+			}
+		});
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void benchCollision(BenchSuite& suite) {
+	const char* meshes[] = { "game_world", "hamster", "hammer" };
+	const float radius = 0.2f;
+	const int steps = 4096;
+
+	for (int m = 0; m < 3; m++) {
+		string name = meshes[m];
+		if (!suite.isSelected("collision_bvh_" + name) && !suite.isSelected("collision_sdf_" + name)) {
+			continue;
+		}
+		vector<Triangle> triangles;
+		if (!loadObj("resources/models/" + name + ".obj", triangles)) {
+			cout << "failed to load resources/models/" << name << ".obj" << endl;
+			continue;
+		}
+
+		FlatBVH bvh;
+		for (const Triangle& t : triangles) {
+			bvh.addTriangle(t.v[0], t.v[1], t.v[2]);
+		}
+		bvh.build();
+
+		float lo[3], hi[3];
+		bvh.getBounds(lo, hi);
+		vector<float> path;
+		toolTrajectory(lo, hi, steps, path);
+
+		vector<pair<string, long long>> params = { make_pair(string("triangles"), (long long)triangles.size()) };
+
+		int i = 0;
+		suite.run("collision_bvh_" + name, params, 1, [&]() {
+			BVHHit hit;
+			bvh.closestPoint(&path[3 * (i++ % steps)], radius, hit);
+		});
+
+		if (suite.isSelected("collision_sdf_" + name)) {
+			DistanceField field;
+			field.bake(bvh, 0.05f, 2.0f * radius);
+			suite.run("collision_sdf_" + name, params, 1, [&]() {
+				float distance, gradient[3];
+				field.query(&path[3 * (i++ % steps)], distance, gradient);
+			});
+		}
+	}
+}
+
+// Hammer head sampled as contact points at several densities, queried against
+// the board in one batch and point by point
+void benchHammerShell(BenchSuite& suite) {
+	if (!suite.isSelected("hammer_points")) {
+		return;
+	}
+	vector<Triangle> board, hammer;
+	if (!loadObj("resources/models/game_world.obj", board) || !loadObj("resources/models/hammer.obj", hammer)) {
+		cout << "failed to load the board or hammer mesh" << endl;
+		return;
+	}
+	FlatBVH bvh;
+	for (const Triangle& t : board) {
+		bvh.addTriangle(t.v[0], t.v[1], t.v[2]);
+	}
+	bvh.build();
+
+	float lo[3], hi[3];
+	bvh.getBounds(lo, hi);
+	const int steps = 4096;
+	vector<float> path;
+	toolTrajectory(lo, hi, steps, path);
+
+	const float spacings[] = { 0.1f, 0.05f, 0.025f, 0.0125f };
+	for (float spacing : spacings) {
+		PointShell shell(0.03f);
+		for (const Triangle& t : hammer) {
+			float c[3];
+			for (int k = 0; k < 3; k++) {
+				c[k] = (t.v[0][k] + t.v[1][k] + t.v[2][k]) / 3.0f;
+			}
+			if (sqrtf(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]) <= 0.3f) {
+				shell.addTriangle(t.v[0], t.v[1], t.v[2], spacing);
+			}
+		}
+		shell.weld(spacing);
+		int n = shell.getNumPoints();
+		vector<BVHHit> hits(n);
+		const float axisX[3] = { 1, 0, 0 };
+		const float axisY[3] = { 0, 1, 0 };
+		const float axisZ[3] = { 0, 0, 1 };
+
+		vector<pair<string, long long>> params = { make_pair(string("points"), (long long)n) };
+
+		int i = 0;
+		suite.run("hammer_points_batched", params, n, [&]() {
+			shell.transform(&path[3 * (i++ % steps)], axisX, axisY, axisZ);
+			bvh.closestPoints(shell.getPoints(), n, shell.getRadius(), hits.data());
+		});
+		suite.run("hammer_points_single", params, n, [&]() {
+			shell.transform(&path[3 * (i++ % steps)], axisX, axisY, axisZ);
+			for (int k = 0; k < n; k++) {
+				bvh.closestPoint(shell.getPoints() + 3 * k, shell.getRadius(), hits[k]);
+			}
+		});
+	}
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char* argv[]) {
+	string jsonPath = "micro_benchmark.json";
+	BenchSuite suite(argc, argv, jsonPath);
+	srand(1);
+
+	benchSpheres(suite);
+	benchSprings(suite);
+	benchParticleSystem(suite);
+	benchSpatialHash(suite);
+	benchHamsters(suite);
+	benchCollision(suite);
+	benchHammerShell(suite);
+
+	if (!suite.writeJson(jsonPath, "hamstercide")) {
+		cout << "failed to write " << jsonPath << endl;
+		return 1;
+	}
+	cout << "results written to " << jsonPath << endl;
+	return 0;
+}
@@ -0,0 +1,182 @@
+//==============================================================================
+/*
+	Spatial hash against brute force on moving spheres
+
+	Moves two identical sets of spheres through a box. One set is binned in a
+	SpatialHash, the other is checked pair by pair. Every step compares the
+	ball queries, the pairs, the cursor forces and the contact forces of both,
+	through the positions and velocities they lead to, and times the force
+	computation of each.
+
+	Build from the repository root against CHAI3D:
+		g++ -O2 -std=c++11 -I. -Ibenchmarks -I<chai3d>/src -I<chai3d>/external/Eigen
+			benchmarks/spatial_hash_benchmark.cpp sphere.cpp spatial_hash.cpp realtime.cpp
+			-L<chai3d>/lib/release/lin-x86_64-cc -lchai3d -lGL -lpthread -o spatial_hash_benchmark
+	Run:
+		./spatial_hash_benchmark [spheres] [steps]
+*/
+//==============================================================================
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "bench.h"
+#include "sphere.h"
+#include "spatial_hash.h"
+
+using namespace std;
+
+// side of the box the spheres move in [m]
+static const double BOX = 0.3;
+// largest sphere radius, the cells are one diameter wide
+static const double MAX_RADIUS = 0.012;
+
+static double uniform() {
+	return rand() / (RAND_MAX + 1.0);
+}
+
+// Spheres inside a query ball, found by testing every one of them
+static void bruteQuery(vector<Sphere*>& spheres, cVector3d p, double r, vector<int>& out) {
+	for (int i = 0; i < (int)spheres.size(); i++) {
+		double d = r + spheres[i]->getRadius();
+		if ((spheres[i]->getPosition() - p).lengthsq() < d * d) {
+			out.push_back(i);
+		}
+	}
+}
+
+// Penetrating pairs with i < j, found by testing every pair
+static void brutePairs(vector<Sphere*>& spheres, vector<pair<int, int>>& out) {
+	for (int i = 0; i < (int)spheres.size(); i++) {
+		for (int j = i + 1; j < (int)spheres.size(); j++) {
+			double d = spheres[i]->getRadius() + spheres[j]->getRadius();
+			if ((spheres[i]->getPosition() - spheres[j]->getPosition()).lengthsq() < d * d) {
+				out.push_back(make_pair(i, j));
+			}
+		}
+	}
+}
+
+int main(int argc, char* argv[]) {
+	int count = argc > 1 ? atoi(argv[1]) : 2000;
+	int steps = argc > 2 ? atoi(argv[2]) : 500;
+	const double dt = 0.001;
+	const double cursorRadius = 0.05;
+
+	// both sets start alike, the hashed one is moved and the other follows
+	srand(1);
+	vector<Sphere*> hashed, brute;
+	SpatialHash hash(2.0 * MAX_RADIUS, 2 * count);
+	for (int i = 0; i < count; i++) {
+		cVector3d p(BOX * uniform(), BOX * uniform(), BOX * uniform());
+		double r = 0.005 + (MAX_RADIUS - 0.005) * uniform();
+		hashed.push_back(new Sphere(p, r));
+		brute.push_back(new Sphere(p, r));
+		cVector3d v(uniform() - 0.5, uniform() - 0.5, uniform() - 0.5);
+		hashed[i]->velocity = v;
+		brute[i]->velocity = v;
+		hash.add(hashed[i]);
+	}
+
+	long long queryMismatches = 0;
+	long long pairMismatches = 0;
+	long long forceMismatches = 0;
+	long long queries = 0;
+	long long pairs = 0;
+	double hashTime = 0.0;
+	double bruteTime = 0.0;
+	vector<int> found, expected;
+	vector<pair<int, int>> foundPairs, expectedPairs;
+
+	for (int step = 0; step < steps; step++) {
+		// balls the size of a sphere and of the cursor anywhere in the box
+		for (int q = 0; q < 64; q++) {
+			cVector3d p(BOX * uniform(), BOX * uniform(), BOX * uniform());
+			double r = q % 2 == 0 ? MAX_RADIUS : cursorRadius;
+			found.clear();
+			expected.clear();
+			hash.query(p, r, found);
+			bruteQuery(brute, p, r, expected);
+			sort(found.begin(), found.end());
+			if (found != expected) {
+				queryMismatches++;
+			}
+			queries++;
+		}
+
+		foundPairs.clear();
+		expectedPairs.clear();
+		hash.findPairs(foundPairs);
+		brutePairs(brute, expectedPairs);
+		sort(foundPairs.begin(), foundPairs.end());
+		if (foundPairs != expectedPairs) {
+			pairMismatches++;
+		}
+		pairs += (long long)expectedPairs.size();
+
+		// the cursor sweeps through the middle of the box
+		double phase = 2.0 * M_PI * step / steps;
+		cVector3d cursor(0.5 * BOX + 0.4 * BOX * cos(phase), 0.5 * BOX + 0.4 * BOX * sin(phase), 0.5 * BOX);
+
+		auto t0 = chrono::steady_clock::now();
+		cVector3d hashForce = hash.calculateCursorForces(cursor, cursorRadius);
+		hash.calculateContactForces();
+		auto t1 = chrono::steady_clock::now();
+		cVector3d bruteForce(0, 0, 0);
+		for (Sphere* s : brute) {
+			bruteForce += s->calculateForces(cursor, cursorRadius);
+		}
+		for (int i = 0; i < count; i++) {
+			for (int j = i + 1; j < count; j++) {
+				brute[i]->calculateContact(brute[j]);
+			}
+		}
+		auto t2 = chrono::steady_clock::now();
+		hashTime += chrono::duration<double>(t1 - t0).count();
+		bruteTime += chrono::duration<double>(t2 - t1).count();
+
+		// the forces are summed in another order, so they agree to rounding
+		if ((hashForce - bruteForce).length() > 1e-9) {
+			forceMismatches++;
+		}
+		for (int i = 0; i < count; i++) {
+			hashed[i]->updateSphere(dt);
+			brute[i]->updateSphere(dt);
+			if ((hashed[i]->getPosition() - brute[i]->getPosition()).length() > 1e-12 ||
+				(hashed[i]->velocity - brute[i]->velocity).length() > 1e-9) {
+				forceMismatches++;
+			}
+
+			// bounce off the walls and keep the sets from drifting apart
+			cVector3d p = hashed[i]->getPosition();
+			cVector3d v = hashed[i]->velocity;
+			for (int k = 0; k < 3; k++) {
+				if ((p(k) < 0.0 && v(k) < 0.0) || (p(k) > BOX && v(k) > 0.0)) {
+					v(k) = -v(k);
+				}
+			}
+			hashed[i]->velocity = v;
+			brute[i]->velocity = v;
+			brute[i]->point->setLocalPos(p);
+		}
+		hash.update();
+	}
+
+	cout << count << " spheres, " << steps << " steps, " << pairs / steps << " pairs per step" << endl;
+	cout << queries << " queries, " << queryMismatches << " mismatches" << endl;
+	cout << steps << " pair searches, " << pairMismatches << " mismatches" << endl;
+	cout << steps << " force steps, " << forceMismatches << " mismatches" << endl;
+	cout << "forces per step: spatial hash " << 1e6 * hashTime / steps << " us, brute force "
+		<< 1e6 * bruteTime / steps << " us" << endl;
+
+	for (int i = 0; i < count; i++) {
+		delete hashed[i];
+		delete brute[i];
+	}
+	bool ok = queryMismatches == 0 && pairMismatches == 0 && forceMismatches == 0;
+	return ok ? 0 : 1;
+}
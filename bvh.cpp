@@ -0,0 +1,636 @@
+#include "bvh.h"
+#include <algorithm>
+#include <cmath>
+#include <float.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BVH_SIMD
+#endif
+
+static inline float dot3(const float a[3], const float b[3]) {
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static inline void sub3(const float a[3], const float b[3], float out[3]) {
+	out[0] = a[0] - b[0];
+	out[1] = a[1] - b[1];
+	out[2] = a[2] - b[2];
+}
+
+static inline float clamp01(float x) {
+	return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+}
+
+static inline float boxArea(const float lo[3], const float hi[3]) {
+	float dx = hi[0] - lo[0];
+	float dy = hi[1] - lo[1];
+	float dz = hi[2] - lo[2];
+	return dx * dy + dy * dz + dz * dx;
+}
+
+FlatBVH::FlatBVH() {
+}
+
+void FlatBVH::addTriangle(const float a[3], const float b[3], const float c[3]) {
+	int base = (int)vertices.size() / 3;
+	vertices.insert(vertices.end(), a, a + 3);
+	vertices.insert(vertices.end(), b, b + 3);
+	vertices.insert(vertices.end(), c, c + 3);
+	indices.push_back(base);
+	indices.push_back(base + 1);
+	indices.push_back(base + 2);
+}
+
+void FlatBVH::clear() {
+	vertices.clear();
+	indices.clear();
+	nodes.clear();
+	vector<float>* soa[] = { &ax, &ay, &az, &abx, &aby, &abz, &acx, &acy, &acz,
+		&bcx, &bcy, &bcz, &nx, &ny, &nz, &invAB, &invAC, &invBC, &invNN };
+	for (vector<float>* v : soa) {
+		v->clear();
+	}
+	triangleIds.clear();
+}
+
+void FlatBVH::build() {
+	int count = getNumTriangles();
+
+	nodes.clear();
+	triangleIds.clear();
+	vector<float>* soa[] = { &ax, &ay, &az, &abx, &aby, &abz, &acx, &acy, &acz,
+		&bcx, &bcy, &bcz, &nx, &ny, &nz, &invAB, &invAC, &invBC, &invNN };
+	for (vector<float>* v : soa) {
+		v->clear();
+		v->reserve(count + count / 2 + LANES);
+	}
+
+	vector<int> order(count);
+	vector<float> centroids(3 * count);
+	for (int i = 0; i < count; i++) {
+		order[i] = i;
+		for (int k = 0; k < 3; k++) {
+			centroids[3 * i + k] = (vertices[3 * indices[3 * i] + k] +
+				vertices[3 * indices[3 * i + 1] + k] +
+				vertices[3 * indices[3 * i + 2] + k]) / 3.0f;
+		}
+	}
+
+	nodes.reserve(2 * (count / LANES + 1));
+	if (count > 0) {
+		build(order, centroids, 0, count, 0);
+	}
+}
+
+int FlatBVH::build(vector<int>& order, vector<float>& centroids, int first, int count, int depth) {
+	Node node;
+	float cmin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float cmax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (int k = 0; k < 3; k++) {
+		node.min[k] = FLT_MAX;
+		node.max[k] = -FLT_MAX;
+	}
+	for (int i = first; i < first + count; i++) {
+		int t = order[i];
+		for (int k = 0; k < 3; k++) {
+			for (int v = 0; v < 3; v++) {
+				float x = vertices[3 * indices[3 * t + v] + k];
+				node.min[k] = min(node.min[k], x);
+				node.max[k] = max(node.max[k], x);
+			}
+			cmin[k] = min(cmin[k], centroids[3 * t + k]);
+			cmax[k] = max(cmax[k], centroids[3 * t + k]);
+		}
+	}
+	node.offset = 0;
+	node.count = 0;
+
+	int index = (int)nodes.size();
+	nodes.push_back(node);
+
+	// a query stack holds at most one node per level plus the siblings left
+	// behind, so past the depth limit the rest goes into one larger leaf
+	if (count <= LEAF_SIZE || depth >= MAX_DEPTH) {
+		storeLeaf(index, order, first, count);
+		return index;
+	}
+
+	// Binned surface area heuristic over the centroid bounds; large triangles
+	// spanning the board would otherwise inflate every box of a median split
+	const int BINS = 16;
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	int bestBin = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		float extent = cmax[axis] - cmin[axis];
+		if (extent <= 0.0f) {
+			continue;
+		}
+		int binCount[BINS] = { 0 };
+		float binMin[BINS][3], binMax[BINS][3];
+		for (int b = 0; b < BINS; b++) {
+			for (int k = 0; k < 3; k++) {
+				binMin[b][k] = FLT_MAX;
+				binMax[b][k] = -FLT_MAX;
+			}
+		}
+		for (int i = first; i < first + count; i++) {
+			int t = order[i];
+			int b = min(BINS - 1, (int)(BINS * (centroids[3 * t + axis] - cmin[axis]) / extent));
+			binCount[b]++;
+			for (int v = 0; v < 3; v++) {
+				for (int k = 0; k < 3; k++) {
+					float x = vertices[3 * indices[3 * t + v] + k];
+					binMin[b][k] = min(binMin[b][k], x);
+					binMax[b][k] = max(binMax[b][k], x);
+				}
+			}
+		}
+
+		// Sweep from the right to get the cost of everything above each plane
+		float rightArea[BINS];
+		int rightCount[BINS];
+		float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		int n = 0;
+		for (int b = BINS - 1; b > 0; b--) {
+			for (int k = 0; k < 3; k++) {
+				lo[k] = min(lo[k], binMin[b][k]);
+				hi[k] = max(hi[k], binMax[b][k]);
+			}
+			n += binCount[b];
+			rightCount[b] = n;
+			rightArea[b] = n > 0 ? boxArea(lo, hi) : 0.0f;
+		}
+		for (int k = 0; k < 3; k++) {
+			lo[k] = FLT_MAX;
+			hi[k] = -FLT_MAX;
+		}
+		n = 0;
+		for (int b = 0; b < BINS - 1; b++) {
+			for (int k = 0; k < 3; k++) {
+				lo[k] = min(lo[k], binMin[b][k]);
+				hi[k] = max(hi[k], binMax[b][k]);
+			}
+			n += binCount[b];
+			if (n == 0 || rightCount[b + 1] == 0) {
+				continue;
+			}
+			float cost = boxArea(lo, hi) * n + rightArea[b + 1] * rightCount[b + 1];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = b;
+			}
+		}
+	}
+
+	int mid;
+	if (bestAxis >= 0) {
+		int axis = bestAxis;
+		float lo = cmin[axis];
+		float extent = cmax[axis] - cmin[axis];
+		mid = (int)(partition(order.begin() + first, order.begin() + first + count,
+			[&](int t) { return min(BINS - 1, (int)(BINS * (centroids[3 * t + axis] - lo) / extent)) <= bestBin; })
+			- order.begin());
+	}
+	else {
+		// All centroids coincide, any even split will do
+		mid = first + count / 2;
+	}
+
+	// The left child is stored right after its parent
+	build(order, centroids, first, mid - first, depth + 1);
+	int right = build(order, centroids, mid, first + count - mid, depth + 1);
+	nodes[index].offset = right;
+	return index;
+}
+
+void FlatBVH::storeLeaf(int index, const vector<int>& order, int first, int count) {
+	int padded = (count + LANES - 1) / LANES * LANES;
+	nodes[index].offset = (uint32_t)ax.size();
+	nodes[index].count = padded;
+
+	// Pad the last block with copies of the last triangle
+	for (int k = 0; k < padded; k++) {
+		int t = order[first + min(k, count - 1)];
+		const float* a = &vertices[3 * indices[3 * t]];
+		const float* b = &vertices[3 * indices[3 * t + 1]];
+		const float* c = &vertices[3 * indices[3 * t + 2]];
+		float ab[3], ac[3], bc[3];
+		sub3(b, a, ab);
+		sub3(c, a, ac);
+		sub3(c, b, bc);
+		float n[3] = { ab[1] * ac[2] - ab[2] * ac[1],
+			ab[2] * ac[0] - ab[0] * ac[2],
+			ab[0] * ac[1] - ab[1] * ac[0] };
+
+		ax.push_back(a[0]); ay.push_back(a[1]); az.push_back(a[2]);
+		abx.push_back(ab[0]); aby.push_back(ab[1]); abz.push_back(ab[2]);
+		acx.push_back(ac[0]); acy.push_back(ac[1]); acz.push_back(ac[2]);
+		bcx.push_back(bc[0]); bcy.push_back(bc[1]); bcz.push_back(bc[2]);
+		nx.push_back(n[0]); ny.push_back(n[1]); nz.push_back(n[2]);
+
+		// A degenerate edge gets a zero reciprocal, so t clamps to 0 and it
+		// measures the distance to its first vertex. A degenerate face never
+		// contains p and is measured by its edges.
+		float ll = dot3(ab, ab);
+		invAB.push_back(ll > FLT_MIN ? 1.0f / ll : 0.0f);
+		ll = dot3(ac, ac);
+		invAC.push_back(ll > FLT_MIN ? 1.0f / ll : 0.0f);
+		ll = dot3(bc, bc);
+		invBC.push_back(ll > FLT_MIN ? 1.0f / ll : 0.0f);
+		ll = dot3(n, n);
+		invNN.push_back(ll > FLT_MIN ? 1.0f / ll : 0.0f);
+
+		triangleIds.push_back(t);
+	}
+}
+
+void FlatBVH::leafDistances(uint32_t slot, const float p[3], float* d2) const {
+#ifdef BVH_SIMD
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	__m128 apx = _mm_sub_ps(_mm_set1_ps(p[0]), _mm_loadu_ps(&ax[slot]));
+	__m128 apy = _mm_sub_ps(_mm_set1_ps(p[1]), _mm_loadu_ps(&ay[slot]));
+	__m128 apz = _mm_sub_ps(_mm_set1_ps(p[2]), _mm_loadu_ps(&az[slot]));
+	__m128 e1x = _mm_loadu_ps(&abx[slot]);
+	__m128 e1y = _mm_loadu_ps(&aby[slot]);
+	__m128 e1z = _mm_loadu_ps(&abz[slot]);
+	__m128 e2x = _mm_loadu_ps(&acx[slot]);
+	__m128 e2y = _mm_loadu_ps(&acy[slot]);
+	__m128 e2z = _mm_loadu_ps(&acz[slot]);
+	__m128 e3x = _mm_loadu_ps(&bcx[slot]);
+	__m128 e3y = _mm_loadu_ps(&bcy[slot]);
+	__m128 e3z = _mm_loadu_ps(&bcz[slot]);
+	__m128 fnx = _mm_loadu_ps(&nx[slot]);
+	__m128 fny = _mm_loadu_ps(&ny[slot]);
+	__m128 fnz = _mm_loadu_ps(&nz[slot]);
+
+	// vector from b to p
+	__m128 bpx = _mm_sub_ps(apx, e1x);
+	__m128 bpy = _mm_sub_ps(apy, e1y);
+	__m128 bpz = _mm_sub_ps(apz, e1z);
+
+#define DOT(ax_, ay_, az_, bx_, by_, bz_) \
+	_mm_add_ps(_mm_add_ps(_mm_mul_ps(ax_, bx_), _mm_mul_ps(ay_, by_)), _mm_mul_ps(az_, bz_))
+
+	// squared distance from p to the segment o + t * e
+#define SEGMENT(wx, wy, wz, ex, ey, ez, inv, out) { \
+		__m128 t = _mm_mul_ps(DOT(wx, wy, wz, ex, ey, ez), inv); \
+		t = _mm_min_ps(_mm_max_ps(t, zero), one); \
+		__m128 dx = _mm_sub_ps(wx, _mm_mul_ps(t, ex)); \
+		__m128 dy = _mm_sub_ps(wy, _mm_mul_ps(t, ey)); \
+		__m128 dz = _mm_sub_ps(wz, _mm_mul_ps(t, ez)); \
+		out = DOT(dx, dy, dz, dx, dy, dz); }
+
+	// n . (u x v)
+#define TRIPLE(ux, uy, uz, vx, vy, vz) \
+	DOT(fnx, fny, fnz, \
+		_mm_sub_ps(_mm_mul_ps(uy, vz), _mm_mul_ps(uz, vy)), \
+		_mm_sub_ps(_mm_mul_ps(uz, vx), _mm_mul_ps(ux, vz)), \
+		_mm_sub_ps(_mm_mul_ps(ux, vy), _mm_mul_ps(uy, vx)))
+
+	__m128 dab, dac, dbc;
+	SEGMENT(apx, apy, apz, e1x, e1y, e1z, _mm_loadu_ps(&invAB[slot]), dab);
+	SEGMENT(apx, apy, apz, e2x, e2y, e2z, _mm_loadu_ps(&invAC[slot]), dac);
+	SEGMENT(bpx, bpy, bpz, e3x, e3y, e3z, _mm_loadu_ps(&invBC[slot]), dbc);
+	__m128 edge = _mm_min_ps(dab, _mm_min_ps(dac, dbc));
+
+	// p projects inside the face when it is on the inner side of all edges
+	__m128 cpx = _mm_sub_ps(apx, e2x);
+	__m128 cpy = _mm_sub_ps(apy, e2y);
+	__m128 cpz = _mm_sub_ps(apz, e2z);
+	__m128 s1 = TRIPLE(e1x, e1y, e1z, apx, apy, apz);
+	__m128 s2 = TRIPLE(e3x, e3y, e3z, bpx, bpy, bpz);
+	__m128 s3 = TRIPLE(cpx, cpy, cpz, e2x, e2y, e2z);
+	__m128 inn = _mm_loadu_ps(&invNN[slot]);
+	__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(s1, zero), _mm_cmpge_ps(s2, zero)),
+		_mm_and_ps(_mm_cmpge_ps(s3, zero), _mm_cmpgt_ps(inn, zero)));
+
+	__m128 h = DOT(apx, apy, apz, fnx, fny, fnz);
+	__m128 plane = _mm_mul_ps(_mm_mul_ps(h, h), inn);
+
+	_mm_storeu_ps(d2, _mm_or_ps(_mm_and_ps(inside, plane), _mm_andnot_ps(inside, edge)));
+
+#undef TRIPLE
+#undef SEGMENT
+#undef DOT
+#else
+	for (int l = 0; l < LANES; l++) {
+		uint32_t s = slot + l;
+		float ap[3] = { p[0] - ax[s], p[1] - ay[s], p[2] - az[s] };
+		float ab[3] = { abx[s], aby[s], abz[s] };
+		float ac[3] = { acx[s], acy[s], acz[s] };
+		float bc[3] = { bcx[s], bcy[s], bcz[s] };
+		float n[3] = { nx[s], ny[s], nz[s] };
+		float bp[3], cp[3];
+		sub3(ap, ab, bp);
+		sub3(ap, ac, cp);
+
+		float edge = FLT_MAX;
+		const float* origins[3] = { ap, ap, bp };
+		const float* edges[3] = { ab, ac, bc };
+		const float inv[3] = { invAB[s], invAC[s], invBC[s] };
+		for (int e = 0; e < 3; e++) {
+			float t = clamp01(dot3(origins[e], edges[e]) * inv[e]);
+			float d[3] = { origins[e][0] - t * edges[e][0],
+				origins[e][1] - t * edges[e][1],
+				origins[e][2] - t * edges[e][2] };
+			edge = min(edge, dot3(d, d));
+		}
+
+		float s1 = n[0] * (ab[1] * ap[2] - ab[2] * ap[1]) + n[1] * (ab[2] * ap[0] - ab[0] * ap[2]) + n[2] * (ab[0] * ap[1] - ab[1] * ap[0]);
+		float s2 = n[0] * (bc[1] * bp[2] - bc[2] * bp[1]) + n[1] * (bc[2] * bp[0] - bc[0] * bp[2]) + n[2] * (bc[0] * bp[1] - bc[1] * bp[0]);
+		float s3 = n[0] * (cp[1] * ac[2] - cp[2] * ac[1]) + n[1] * (cp[2] * ac[0] - cp[0] * ac[2]) + n[2] * (cp[0] * ac[1] - cp[1] * ac[0]);
+		if (s1 >= 0.0f && s2 >= 0.0f && s3 >= 0.0f && invNN[s] > 0.0f) {
+			float h = dot3(ap, n);
+			d2[l] = h * h * invNN[s];
+		}
+		else {
+			d2[l] = edge;
+		}
+	}
+#endif
+}
+
+static inline float boxDistance2(const float lo[3], const float hi[3], const float p[3]) {
+	float d2 = 0.0f;
+	for (int k = 0; k < 3; k++) {
+		float d = max(lo[k] - p[k], 0.0f) + max(p[k] - hi[k], 0.0f);
+		d2 += d * d;
+	}
+	return d2;
+}
+
+bool FlatBVH::closestPoint(const float p[3], float maxDistance, BVHHit& hit) const {
+	if (nodes.empty()) {
+		return false;
+	}
+
+	float best = maxDistance * maxDistance;
+	int bestSlot = -1;
+
+	uint32_t stack[STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		uint32_t index = stack[--top];
+		const Node& node = nodes[index];
+		if (boxDistance2(node.min, node.max, p) > best) {
+			continue;
+		}
+
+		if (node.count > 0) {
+			for (uint32_t k = 0; k < node.count; k += LANES) {
+				float d2[LANES];
+				leafDistances(node.offset + k, p, d2);
+				for (int l = 0; l < LANES; l++) {
+					if (d2[l] < best) {
+						best = d2[l];
+						bestSlot = node.offset + k + l;
+					}
+				}
+			}
+			continue;
+		}
+
+		// Visit the nearer child first by pushing it last
+		uint32_t left = index + 1;
+		uint32_t right = node.offset;
+		float dl = boxDistance2(nodes[left].min, nodes[left].max, p);
+		float dr = boxDistance2(nodes[right].min, nodes[right].max, p);
+		if (dl < dr) {
+			if (dr <= best) stack[top++] = right;
+			if (dl <= best) stack[top++] = left;
+		}
+		else {
+			if (dl <= best) stack[top++] = left;
+			if (dr <= best) stack[top++] = right;
+		}
+	}
+
+	if (bestSlot < 0) {
+		return false;
+	}
+	makeHit(bestSlot, best, p, hit);
+	return true;
+}
+
+static inline bool boxesOverlap(const float lo0[3], const float hi0[3], const float lo1[3], const float hi1[3]) {
+	return lo0[0] <= hi1[0] && lo1[0] <= hi0[0] &&
+		lo0[1] <= hi1[1] && lo1[1] <= hi0[1] &&
+		lo0[2] <= hi1[2] && lo1[2] <= hi0[2];
+}
+
+int FlatBVH::closestPoints(const float* points, int count, float maxDistance, BVHHit* hits) const {
+	for (int i = 0; i < count; i++) {
+		hits[i].triangle = -1;
+	}
+	if (nodes.empty() || count <= 0) {
+		return 0;
+	}
+
+	// Box around every point grown by the query distance
+	float lo[3], hi[3];
+	for (int k = 0; k < 3; k++) {
+		lo[k] = hi[k] = points[k];
+	}
+	for (int i = 1; i < count; i++) {
+		for (int k = 0; k < 3; k++) {
+			lo[k] = min(lo[k], points[3 * i + k]);
+			hi[k] = max(hi[k], points[3 * i + k]);
+		}
+	}
+	for (int k = 0; k < 3; k++) {
+		lo[k] -= maxDistance;
+		hi[k] += maxDistance;
+	}
+
+	// One walk of the tree collects the leaves all points have to look at
+	uint32_t leaves[MAX_BATCH_LEAVES];
+	int numLeaves = 0;
+	uint32_t stack[STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		uint32_t index = stack[--top];
+		const Node& node = nodes[index];
+		if (!boxesOverlap(node.min, node.max, lo, hi)) {
+			continue;
+		}
+		if (node.count > 0) {
+			if (numLeaves == MAX_BATCH_LEAVES) {
+				// Too spread out to share, fall back to one walk per point
+				int contacts = 0;
+				for (int i = 0; i < count; i++) {
+					if (closestPoint(&points[3 * i], maxDistance, hits[i])) {
+						contacts++;
+					}
+					else {
+						hits[i].triangle = -1;
+					}
+				}
+				return contacts;
+			}
+			leaves[numLeaves++] = index;
+			continue;
+		}
+		stack[top++] = node.offset;
+		stack[top++] = index + 1;
+	}
+
+	int contacts = 0;
+	for (int i = 0; i < count; i++) {
+		const float* p = &points[3 * i];
+		float best = maxDistance * maxDistance;
+		int bestSlot = -1;
+		for (int l = 0; l < numLeaves; l++) {
+			const Node& node = nodes[leaves[l]];
+			if (boxDistance2(node.min, node.max, p) > best) {
+				continue;
+			}
+			for (uint32_t k = 0; k < node.count; k += LANES) {
+				float d2[LANES];
+				leafDistances(node.offset + k, p, d2);
+				for (int j = 0; j < LANES; j++) {
+					if (d2[j] < best) {
+						best = d2[j];
+						bestSlot = node.offset + k + j;
+					}
+				}
+			}
+		}
+		if (bestSlot >= 0) {
+			makeHit(bestSlot, best, p, hits[i]);
+			contacts++;
+		}
+	}
+	return contacts;
+}
+
+void FlatBVH::makeHit(int slot, float distance2, const float p[3], BVHHit& hit) const {
+	hit.triangle = triangleIds[slot];
+	hit.distance = sqrtf(distance2);
+	closestPointOnTriangle(hit.triangle, p, hit.point);
+
+	// Push out along the separation, or along the face when p lies on it.
+	// Behind the face the separation points inside, so both flip.
+	float d[3];
+	sub3(p, hit.point, d);
+	float length = sqrtf(dot3(d, d));
+	float n[3] = { nx[slot], ny[slot], nz[slot] };
+	if (dot3(d, n) < 0.0f) {
+		hit.distance = -hit.distance;
+		d[0] = -d[0];
+		d[1] = -d[1];
+		d[2] = -d[2];
+	}
+	if (length < 1e-6f) {
+		d[0] = n[0];
+		d[1] = n[1];
+		d[2] = n[2];
+		length = sqrtf(dot3(d, d));
+	}
+	for (int k = 0; k < 3; k++) {
+		hit.normal[k] = length > 0.0f ? d[k] / length : 0.0f;
+	}
+}
+
+void FlatBVH::closestPointOnTriangle(int triangle, const float p[3], float out[3]) const {
+	// Voronoi region test from Ericson, Real-Time Collision Detection 5.1.5
+	const float* a = &vertices[3 * indices[3 * triangle]];
+	const float* b = &vertices[3 * indices[3 * triangle + 1]];
+	const float* c = &vertices[3 * indices[3 * triangle + 2]];
+	float ab[3], ac[3], ap[3], bp[3], cp[3];
+	sub3(b, a, ab);
+	sub3(c, a, ac);
+	sub3(p, a, ap);
+	sub3(p, b, bp);
+	sub3(p, c, cp);
+
+	float d1 = dot3(ab, ap);
+	float d2 = dot3(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) {
+		out[0] = a[0]; out[1] = a[1]; out[2] = a[2];
+		return;
+	}
+	float d3 = dot3(ab, bp);
+	float d4 = dot3(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3) {
+		out[0] = b[0]; out[1] = b[1]; out[2] = b[2];
+		return;
+	}
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+		float v = d1 / (d1 - d3);
+		for (int k = 0; k < 3; k++) out[k] = a[k] + v * ab[k];
+		return;
+	}
+	float d5 = dot3(ab, cp);
+	float d6 = dot3(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6) {
+		out[0] = c[0]; out[1] = c[1]; out[2] = c[2];
+		return;
+	}
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+		float w = d2 / (d2 - d6);
+		for (int k = 0; k < 3; k++) out[k] = a[k] + w * ac[k];
+		return;
+	}
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+		float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		for (int k = 0; k < 3; k++) out[k] = b[k] + w * (c[k] - b[k]);
+		return;
+	}
+	float sum = va + vb + vc;
+	float v = sum != 0.0f ? vb / sum : 0.0f;
+	float w = sum != 0.0f ? vc / sum : 0.0f;
+	for (int k = 0; k < 3; k++) out[k] = a[k] + ab[k] * v + ac[k] * w;
+}
+
+void FlatBVH::getTriangleNormal(int triangle, float out[3]) const {
+	const float* a = &vertices[3 * indices[3 * triangle]];
+	const float* b = &vertices[3 * indices[3 * triangle + 1]];
+	const float* c = &vertices[3 * indices[3 * triangle + 2]];
+	float ab[3], ac[3];
+	sub3(b, a, ab);
+	sub3(c, a, ac);
+	out[0] = ab[1] * ac[2] - ab[2] * ac[1];
+	out[1] = ab[2] * ac[0] - ab[0] * ac[2];
+	out[2] = ab[0] * ac[1] - ab[1] * ac[0];
+	float length = sqrtf(dot3(out, out));
+	for (int k = 0; k < 3; k++) {
+		out[k] = length > 0.0f ? out[k] / length : 0.0f;
+	}
+}
+
+uint64_t FlatBVH::getHash() const {
+	// FNV-1a over the raw triangle corners
+	uint64_t hash = 14695981039346656037ULL;
+	const unsigned char* bytes = (const unsigned char*)vertices.data();
+	for (size_t i = 0; i < vertices.size() * sizeof(float); i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+int FlatBVH::getNumTriangles() const {
+	return (int)indices.size() / 3;
+}
+
+int FlatBVH::getNumNodes() const {
+	return (int)nodes.size();
+}
+
+void FlatBVH::getBounds(float min[3], float max[3]) const {
+	for (int k = 0; k < 3; k++) {
+		min[k] = nodes.empty() ? 0.0f : nodes[0].min[k];
+		max[k] = nodes.empty() ? 0.0f : nodes[0].max[k];
+	}
+}
@@ -0,0 +1,94 @@
+#ifndef bvh_h
+#define bvh_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+// Closest triangle found by a proximity query. The distance is negative when
+// the point is behind the face of that triangle, the normal always points to
+// its front side.
+struct BVHHit {
+	float distance;
+	float point[3];
+	float normal[3];
+	int triangle;
+};
+
+// Bounding volume hierarchy stored as a flat depth-first array of compact
+// nodes. The left child of a node always follows it, so only the right child
+// index is stored. Leaf triangles are kept as structure of arrays in blocks of
+// four so one SIMD kernel measures the distance to four triangles at once.
+class FlatBVH {
+	static const int LEAF_SIZE = 8;
+	// deepest leaf, so the fixed stacks of the queries never overflow
+	static const int MAX_DEPTH = 48;
+	static const int STACK_SIZE = 64;
+	static const int LANES = 4;
+	// leaves a batched query shares between its points
+	static const int MAX_BATCH_LEAVES = 256;
+
+	struct Node {
+		float min[3];
+		// right child of an interior node, first triangle slot of a leaf
+		uint32_t offset;
+		float max[3];
+		// number of triangle slots of a leaf, 0 for interior nodes
+		uint32_t count;
+	};
+
+	// Triangles before the build
+	vector<float> vertices;
+	vector<int> indices;
+
+	vector<Node> nodes;
+
+	// Leaf triangles in SoA layout: vertex a, edges ab, ac, bc, the unscaled
+	// normal and the reciprocal squared lengths used by the distance kernel
+	vector<float> ax, ay, az;
+	vector<float> abx, aby, abz;
+	vector<float> acx, acy, acz;
+	vector<float> bcx, bcy, bcz;
+	vector<float> nx, ny, nz;
+	vector<float> invAB, invAC, invBC, invNN;
+	vector<int> triangleIds;
+
+	int build(vector<int>& order, vector<float>& centroids, int first, int count, int depth);
+	void storeLeaf(int index, const vector<int>& order, int first, int count);
+	void leafDistances(uint32_t slot, const float p[3], float* d2) const;
+	void makeHit(int slot, float distance2, const float p[3], BVHHit& hit) const;
+
+public:
+
+	FlatBVH();
+
+	// Adds a triangle given by its three corners
+	void addTriangle(const float a[3], const float b[3], const float c[3]);
+	// Builds the tree over all added triangles
+	void build();
+	// Drops all triangles and nodes
+	void clear();
+
+	// Finds the closest triangle within maxDistance of p, returns false if none
+	bool closestPoint(const float p[3], float maxDistance, BVHHit& hit) const;
+	// Runs closestPoint for count points given as xyz triples. The tree is
+	// walked once for the box around all of them and every point only visits
+	// the leaves found. Points without contact get a triangle of -1, the
+	// number of points in contact is returned.
+	int closestPoints(const float* points, int count, float maxDistance, BVHHit* hits) const;
+	// Returns the closest point on a triangle given by its original index
+	void closestPointOnTriangle(int triangle, const float p[3], float out[3]) const;
+	// Returns the unit normal of a triangle given by its original index
+	void getTriangleNormal(int triangle, float out[3]) const;
+	// Returns a hash of the triangle data, used to validate baked caches
+	uint64_t getHash() const;
+
+	int getNumTriangles() const;
+	int getNumNodes() const;
+	void getBounds(float min[3], float max[3]) const;
+
+};
+
+#endif
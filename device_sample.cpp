@@ -0,0 +1,118 @@
+#include "device_sample.h"
+
+VelocityEstimator::VelocityEstimator(double jerk, double position) {
+	jerkNoise = jerk;
+	positionNoise = position;
+	for (int k = 0; k < 3; k++) {
+		reset(axes[k], 0.0);
+	}
+}
+
+void VelocityEstimator::reset() {
+	started = false;
+}
+
+void VelocityEstimator::reset(Axis& axis, double x) {
+	axis.x = x;
+	axis.v = 0.0;
+	axis.a = 0.0;
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			axis.P[i][j] = 0.0;
+		}
+	}
+	// the position is known, the motion is not
+	axis.P[0][0] = positionNoise;
+	axis.P[1][1] = 1.0;
+	axis.P[2][2] = 100.0;
+}
+
+void VelocityEstimator::update(Axis& axis, double z, double dt) {
+	// predict with constant acceleration over the tick
+	double dt2 = dt * dt;
+	double x = axis.x + axis.v * dt + 0.5 * axis.a * dt2;
+	double v = axis.v + axis.a * dt;
+	double a = axis.a;
+
+	// P = F P F' + Q, with F = [1 dt dt2/2; 0 1 dt; 0 0 1] and Q from white jerk
+	double (&P)[3][3] = axis.P;
+	double FP[3][3];
+	for (int j = 0; j < 3; j++) {
+		FP[0][j] = P[0][j] + dt * P[1][j] + 0.5 * dt2 * P[2][j];
+		FP[1][j] = P[1][j] + dt * P[2][j];
+		FP[2][j] = P[2][j];
+	}
+	double q = jerkNoise;
+	double dt3 = dt2 * dt;
+	double Q[3][3] = {
+		{ q * dt3 * dt2 / 20.0, q * dt2 * dt2 / 8.0, q * dt3 / 6.0 },
+		{ q * dt2 * dt2 / 8.0, q * dt3 / 3.0, q * dt2 / 2.0 },
+		{ q * dt3 / 6.0, q * dt2 / 2.0, q * dt }
+	};
+	for (int i = 0; i < 3; i++) {
+		P[i][0] = FP[i][0] + dt * FP[i][1] + 0.5 * dt2 * FP[i][2] + Q[i][0];
+		P[i][1] = FP[i][1] + dt * FP[i][2] + Q[i][1];
+		P[i][2] = FP[i][2] + Q[i][2];
+	}
+
+	// correct with the measured position, H = [1 0 0]
+	double s = P[0][0] + positionNoise;
+	double K[3] = { P[0][0] / s, P[1][0] / s, P[2][0] / s };
+	double r = z - x;
+	axis.x = x + K[0] * r;
+	axis.v = v + K[1] * r;
+	axis.a = a + K[2] * r;
+
+	double row[3] = { P[0][0], P[0][1], P[0][2] };
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			P[i][j] -= K[i] * row[j];
+		}
+	}
+}
+
+void VelocityEstimator::update(double time, const cVector3d& position, cVector3d& velocity, cVector3d& acceleration) {
+	double dt = time - lastTime;
+	lastTime = time;
+
+	// a first sample or a long stall starts over
+	if (!started || dt <= 0.0 || dt > 0.05) {
+		for (int k = 0; k < 3; k++) {
+			reset(axes[k], position(k));
+		}
+		started = true;
+	}
+	else {
+		for (int k = 0; k < 3; k++) {
+			update(axes[k], position(k), dt);
+		}
+	}
+	velocity.set(axes[0].v, axes[1].v, axes[2].v);
+	acceleration.set(axes[0].a, axes[1].a, axes[2].a);
+}
+
+//------------------------------------------------------------------------------
+
+DeviceSampler::DeviceSampler(const VelocityEstimator& e) : estimator(e) {
+}
+
+void DeviceSampler::setWorkspaceScale(double s) {
+	scale = s > 0.0 ? s : 1.0;
+}
+
+void DeviceSampler::sample(cToolCursor* tool, double time, DeviceSample& out) {
+	out.time = time;
+	out.localPosition = tool->getDeviceLocalPos();
+	out.globalPosition = tool->getDeviceGlobalPos();
+	out.globalRotation = tool->getDeviceGlobalRot();
+	out.rawVelocity = tool->getDeviceLocalLinVel();
+	out.force = tool->getDeviceLocalForce();
+
+	cVector3d velocity, acceleration;
+	estimator.update(time, out.localPosition / scale, velocity, acceleration);
+	out.localVelocity = scale * velocity;
+	out.localAcceleration = scale * acceleration;
+
+	// the tool frame only carries the device frame into the world
+	out.globalVelocity = tool->getGlobalRot() * out.localVelocity;
+}
@@ -0,0 +1,79 @@
+#ifndef device_sample_h
+#define device_sample_h
+
+#include <stdio.h>
+#include "chai3d.h"
+
+using namespace chai3d;
+using namespace std;
+
+// Everything the haptic tick needs from the device, read once right after the
+// tool is updated. Positions and velocities are in the virtual workspace.
+struct DeviceSample {
+	double time = 0.0;
+	// device position in the tool frame and in the world
+	cVector3d localPosition;
+	cVector3d globalPosition;
+	cMatrix3d globalRotation;
+	// filtered velocity and acceleration in the tool frame, and the velocity
+	// in the world
+	cVector3d localVelocity;
+	cVector3d localAcceleration;
+	cVector3d globalVelocity;
+	// velocity reported by the device
+	cVector3d rawVelocity;
+	// force sent to the device over the previous tick [N]
+	cVector3d force;
+};
+
+// Constant acceleration Kalman filter on each axis of the device position.
+// It runs on the physical position so its noise settings do not depend on
+// the workspace scale. Its steady state follows a constant acceleration
+// without lag, so the delay at hand motion frequencies stays under a tick,
+// while most of the quantization noise of finite differences is removed.
+class VelocityEstimator {
+	struct Axis {
+		double x = 0.0;
+		double v = 0.0;
+		double a = 0.0;
+		double P[3][3];
+	};
+
+	// spectral density of the jerk of the hand [m^2/s^5]
+	double jerkNoise;
+	// variance of a position reading [m^2]
+	double positionNoise;
+
+	Axis axes[3];
+	double lastTime = 0.0;
+	bool started = false;
+
+	void reset(Axis& axis, double x);
+	void update(Axis& axis, double x, double dt);
+
+public:
+
+	VelocityEstimator(double jerkNoise = 2e4, double positionNoise = 1e-9);
+
+	// Forgets the motion, the next position starts over at rest
+	void reset();
+	// Filters a position [m] read at the given time [s]
+	void update(double time, const cVector3d& position, cVector3d& velocity, cVector3d& acceleration);
+};
+
+// Takes one sample of the tool per tick
+class DeviceSampler {
+	VelocityEstimator estimator;
+	double scale = 1.0;
+
+public:
+
+	DeviceSampler(const VelocityEstimator& estimator = VelocityEstimator());
+
+	// Scale from the physical workspace of the device to the virtual one
+	void setWorkspaceScale(double scale);
+	// Reads the tool, after its update from the device, into a sample
+	void sample(cToolCursor* tool, double time, DeviceSample& out);
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include "frame_pipeline.h"
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <mmsystem.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+FramePipeline::FramePipeline(int frames) {
+	maxFrames = frames < 1 ? 1 : (frames > MAX_FRAMES ? MAX_FRAMES : frames);
+}
+
+static long long steadyNow() {
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FramePipeline::init() {
+#ifdef GLEW_VERSION
+	fences = GLEW_ARB_sync != 0;
+	timestamps = fences && GLEW_ARB_timer_query != 0;
+	if (timestamps) {
+		glGenQueries(MAX_FRAMES, queries);
+	}
+#endif
+}
+
+void FramePipeline::release() {
+#ifdef GLEW_VERSION
+	while (fences && inFlight > 0) {
+		glDeleteSync(frames[(head + MAX_FRAMES - inFlight) % MAX_FRAMES]);
+		inFlight--;
+	}
+	if (timestamps) {
+		glDeleteQueries(MAX_FRAMES, queries);
+		timestamps = false;
+	}
+#endif
+}
+
+void FramePipeline::retire(long long detected) {
+	int oldest = (head + MAX_FRAMES - inFlight) % MAX_FRAMES;
+	long long done = detected;
+#ifdef GLEW_VERSION
+	// the fence passed, so the timestamp before it is available
+	if (timestamps) {
+		GLint64 gpu = 0;
+		glGetQueryObjecti64v(queries[oldest], GL_QUERY_RESULT, &gpu);
+		done = gpu + offsets[oldest];
+	}
+	glDeleteSync(frames[oldest]);
+#endif
+	completed[ids[oldest] % MAX_FRAMES] = done;
+	retired = ids[oldest] + 1;
+	inFlight--;
+}
+
+void FramePipeline::beginFrame() {
+	frameCount++;
+#ifdef GLEW_VERSION
+	if (!fences) {
+		return;
+	}
+	// only the oldest frame is waited for, the younger ones keep drawing
+	while (inFlight >= maxFrames) {
+		int oldest = (head + MAX_FRAMES - inFlight) % MAX_FRAMES;
+		auto start = chrono::steady_clock::now();
+		glClientWaitSync(frames[oldest], GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);
+		blocked += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		retire(steadyNow());
+	}
+#endif
+}
+
+long long FramePipeline::endFrame() {
+	long long id = submitted++;
+#ifdef GLEW_VERSION
+	if (!fences) {
+		return id;
+	}
+	if (timestamps) {
+		// the GPU clock is read next to the steady clock to map one onto the other
+		glQueryCounter(queries[head], GL_TIMESTAMP);
+		GLint64 gpu = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpu);
+		offsets[head] = steadyNow() - gpu;
+	}
+	frames[head] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	ids[head] = id;
+	head = (head + 1) % MAX_FRAMES;
+	inFlight++;
+#endif
+	return id;
+}
+
+void FramePipeline::poll() {
+#ifdef GLEW_VERSION
+	while (fences && inFlight > 0) {
+		int oldest = (head + MAX_FRAMES - inFlight) % MAX_FRAMES;
+		GLenum status = glClientWaitSync(frames[oldest], 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+			return;
+		}
+		retire(steadyNow());
+	}
+#endif
+}
+
+bool FramePipeline::getCompletionTime(long long frame, long long& time) const {
+	// older frames had their slot reused by younger ones
+	if (frame >= retired || frame < retired - MAX_FRAMES) {
+		return false;
+	}
+	time = completed[frame % MAX_FRAMES];
+	return true;
+}
+
+bool FramePipeline::hasFences() const {
+	return fences;
+}
+
+double FramePipeline::getBlockedTime() const {
+	return frameCount > 0 ? blocked / frameCount : 0.0;
+}
+
+//------------------------------------------------------------------------------
+
+FramePacer::FramePacer() {
+#if defined(_WIN32)
+	// sleeps are otherwise rounded up to the 15.6 ms scheduler tick
+	timeBeginPeriod(1);
+#endif
+}
+
+FramePacer::~FramePacer() {
+#if defined(_WIN32)
+	timeEndPeriod(1);
+#endif
+}
+
+void FramePacer::wait(double now, double swapTime, double period) {
+	// the work is expected to take its average plus some spread
+	double expected = work + 2.0 * deviation + margin;
+	double start = swapTime + period - expected;
+	if (period > 0.0 && start > now) {
+		// sleep most of the way and spin the rest, so a late wake up does not
+		// miss the refresh
+		auto until = chrono::steady_clock::now() + chrono::duration<double>(start - now);
+		if (start - now > spin) {
+			this_thread::sleep_for(chrono::duration<double>(start - now - spin));
+		}
+		while (chrono::steady_clock::now() < until) {
+			this_thread::yield();
+		}
+		totalSleep += start - now;
+	}
+}
+
+void FramePacer::beginWork(double time) {
+	workStart = time;
+}
+
+void FramePacer::endWork(double time) {
+	double measured = time - workStart;
+	if (frameCount++ == 0) {
+		work = measured;
+	}
+	deviation += smoothing * (fabs(measured - work) - deviation);
+	work += smoothing * (measured - work);
+	totalWork += measured;
+}
+
+double FramePacer::getWorkTime() const {
+	return work;
+}
+
+void FramePacer::printSummary(ostream& out, const FramePipeline& pipeline) {
+	double n = frameCount > 0 ? (double)frameCount : 1.0;
+	out << "graphics: " << 1000.0 * totalWork / n << " ms of work, of which " << 1000.0 * pipeline.getBlockedTime()
+		<< " ms waiting for the GPU, and " << 1000.0 * totalSleep / n << " ms paced per frame"
+		<< (pipeline.hasFences() ? "" : " (no fences)") << endl;
+}
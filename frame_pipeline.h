@@ -0,0 +1,110 @@
+#ifndef frame_pipeline_h
+#define frame_pipeline_h
+
+#include <stdio.h>
+#include <iostream>
+#include "chai3d.h"
+
+using namespace chai3d;
+using namespace std;
+
+// Lets the CPU prepare the next frames while the GPU still draws the previous
+// ones. A fence follows every frame, and a new frame only waits for the frame
+// that is maxFrames behind it instead of draining the GPU.
+// Without fence support (no GLEW or no ARB_sync) the swap chain alone bounds
+// the frames in flight.
+class FramePipeline {
+	static const int MAX_FRAMES = 4;
+
+	int maxFrames;
+	bool fences = false;
+	// GPU timestamps of the end of each frame, with ARB_timer_query
+	bool timestamps = false;
+#ifdef GLEW_VERSION
+	GLsync frames[MAX_FRAMES];
+	GLuint queries[MAX_FRAMES];
+#endif
+	// steady clock minus GPU clock when each frame was ended [ns]
+	long long offsets[MAX_FRAMES];
+	long long ids[MAX_FRAMES];
+	int head = 0;
+	int inFlight = 0;
+
+	// frames ended so far, frames whose fence signaled, and the completion
+	// time of the last few of them [ns]
+	long long submitted = 0;
+	long long retired = 0;
+	long long completed[MAX_FRAMES];
+
+	long long frameCount = 0;
+	double blocked = 0.0;
+
+	// Forgets the fence of the oldest frame, which has signaled at the given
+	// time unless the GPU timestamp tells better
+	void retire(long long detected);
+
+public:
+
+	FramePipeline(int maxFrames = 2);
+
+	// Checks for fence support, with the display context current
+	void init();
+	// Deletes the fences still in flight, with the display context current.
+	// Call it before the window is destroyed, nothing is released later.
+	void release();
+	// Waits until fewer than maxFrames frames are in flight
+	void beginFrame();
+	// Marks the end of the commands of the frame and returns its number
+	long long endFrame();
+	// Retires the frames whose fence has signaled, without waiting
+	void poll();
+	// Time the GPU finished a frame, in nanoseconds on the steady clock, the
+	// clock of the tracer. False while it is in flight, long gone or when
+	// there are no fences.
+	bool getCompletionTime(long long frame, long long& time) const;
+
+	bool hasFences() const;
+	// Average time spent waiting for the GPU per frame [s]
+	double getBlockedTime() const;
+};
+
+// Starts a frame as late as its measured CPU time allows, so the poses it
+// shows are sampled close to the refresh instead of right after the last one
+class FramePacer {
+	double work = 0.0;
+	double deviation = 0.0;
+	double workStart = 0.0;
+
+	long long frameCount = 0;
+	double totalWork = 0.0;
+	double totalSleep = 0.0;
+
+public:
+
+	// Weight of a new measure in the averages
+	double smoothing = 0.05;
+	// Time kept in reserve besides the average and spread of the work [s]
+	double margin = 0.002;
+	// Last part of the wait that is spun instead of slept, a sleep can wake
+	// up late by about the timer resolution [s]
+	double spin = 0.001;
+
+	// Raises the timer resolution to 1 ms where the default is coarser
+	FramePacer();
+	~FramePacer();
+
+	// Sleeps until the work of the next frame should start, given the current
+	// time, the time the last swap returned and the refresh period [s]
+	void wait(double now, double swapTime, double period);
+	// Marks the start and the end of the CPU work of a frame [s], the start
+	// comes before the wait for the GPU so that wait counts as work
+	void beginWork(double time);
+	void endWork(double time);
+
+	// Average CPU time of a frame [s]
+	double getWorkTime() const;
+
+	void printSummary(ostream& out, const FramePipeline& pipeline);
+};
+
+#endif
@@ -0,0 +1,217 @@
+#include "game.h"
+#include <cmath>
+
+GameInstance::GameInstance(const GameConfig& c, uint64_t seed) :
+	config(c), count(c.grid * c.grid), state(count, 0), motion(count), active(count, false),
+	popTime(count, 0.0), flightIndex(count, -1), behaviours(count, 512), slots(count, -1) {
+	// every hamster may be in flight at once, the list never grows past this
+	inFlight.reserve(count);
+
+	// a zero state would stay zero
+	rng = seed ^ 0x9e3779b97f4a7c15ULL;
+	if (rng == 0) {
+		rng = 1;
+	}
+}
+
+void GameInstance::start(double time) {
+	// drop the behaviours of the previous round
+	behaviours.clear(time);
+
+	hits = 0;
+	misses = 0;
+	popups = 0;
+	escapes = 0;
+	hitLatency = 0.0;
+	raised = true;
+
+	inFlight.clear();
+	for (int id = 0; id < count; id++) {
+		state[id] = 0;
+		flightIndex[id] = -1;
+		active[id] = false;
+		motion[id].start(time, config.hamsterBottom, config.hamsterBottom, 0.0);
+		slots[id] = behaviours.spawn(hamsterBehaviour(behaviours, *this, id));
+		if (slots[id] < 0) {
+			printf("error - no room for the behaviour of hamster %d\n", id);
+		}
+	}
+}
+
+void GameInstance::advance(double time) {
+	behaviours.advance(time);
+}
+
+void GameInstance::move(int id, double to, double duration, Easing easing) {
+	double time = behaviours.getTime();
+	double current = motion[id].evaluate(time);
+	motion[id].start(time, current, to, duration, easing);
+	if (flightIndex[id] < 0) {
+		flightIndex[id] = (int)inFlight.size();
+		inFlight.push_back(id);
+	}
+
+	// back in the scene from the moment it starts rising
+	if (to > current) {
+		active[id] = true;
+	}
+}
+
+void GameInstance::land(int id) {
+	int index = flightIndex[id];
+	if (index < 0) {
+		return;
+	}
+	// the last id takes the place of the one that landed
+	int last = inFlight.back();
+	inFlight[index] = last;
+	flightIndex[last] = index;
+	inFlight.pop_back();
+	flightIndex[id] = -1;
+}
+
+Behaviour GameInstance::hamsterBehaviour(BehaviourScheduler& scheduler, GameInstance& game, int id) {
+	const GameConfig& c = game.config;
+	while (true) {
+		// Hamster waits at the bottom
+		game.state[id] = 0;
+		co_await scheduler.sleep(game.randomExponential(c.hamsterHiddenTime));
+
+		// Hamster pops up, from now on a hit knocks it out
+		game.state[id] = 1;
+		game.popups++;
+		game.popTime[id] = scheduler.getTime();
+		game.move(id, c.hamsterTop, c.hamsterRiseTime, EASE_OUT);
+		bool hit = co_await scheduler.waitEvent(c.hamsterRiseTime);
+
+		// Hamster reached the top, the wait ends with its motion
+		if (!hit) {
+			game.land(id);
+			game.state[id] = 2;
+			hit = co_await scheduler.waitEvent(game.randomExponential(c.hamsterStayTime));
+		}
+
+		// Hamster is at the top and leaves
+		if (!hit) {
+			game.state[id] = 4;
+			game.move(id, c.hamsterBottom, c.hamsterHideTime, EASE_IN_OUT);
+			hit = co_await scheduler.waitEvent(c.hamsterHideTime);
+			if (!hit) {
+				game.land(id);
+				game.escapes++;
+			}
+		}
+
+		// Move hamster down forcefully
+		if (hit) {
+			game.state[id] = 5;
+			game.move(id, c.hamsterBottom, c.hamsterKnockTime, EASE_IN);
+			co_await scheduler.sleep(c.hamsterKnockTime);
+			game.land(id);
+		}
+
+		// Hamster is unconcious or knocked out at the bottom, out of the
+		// scene until it comes back
+		game.active[id] = false;
+		co_await scheduler.sleep(game.randomExponential(c.hamsterRecoverTime));
+	}
+}
+
+void GameInstance::liftHammer() {
+	raised = true;
+}
+
+bool GameInstance::strikeHamster(int id) {
+	// Hammer is no longer in raised position
+	raised = false;
+
+	// If hamster is not knocked out, its behaviour takes the hit
+	if (!behaviours.signal(slots[id])) {
+		return false;
+	}
+	hits++;
+	hitLatency += behaviours.getTime() - popTime[id];
+	return true;
+}
+
+void GameInstance::strikeBoard() {
+	if (raised) {
+		raised = false;
+		misses++;
+	}
+}
+
+double GameInstance::random() {
+	// xorshift64*
+	rng ^= rng >> 12;
+	rng ^= rng << 25;
+	rng ^= rng >> 27;
+	return (double)((rng * 0x2545f4914f6cdd1dULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double GameInstance::randomExponential(double mean) {
+	return -mean * log(1.0 - random());
+}
+
+const GameConfig& GameInstance::getConfig() const {
+	return config;
+}
+
+int GameInstance::getNumHamsters() const {
+	return count;
+}
+
+void GameInstance::getPosition(int id, double& x, double& y) const {
+	double center = 0.5 * (config.grid - 1);
+	x = (id / config.grid - center) * config.spacing;
+	y = (id % config.grid - center) * config.spacing;
+}
+
+int GameInstance::getState(int id) const {
+	return state[id];
+}
+
+const Motion& GameInstance::getMotion(int id) const {
+	return motion[id];
+}
+
+double GameInstance::getHeight(int id, double time) const {
+	// the timers may wake a behaviour up to a tick before its motion ends, a
+	// landed hamster is exactly at the end of the curve
+	if (flightIndex[id] < 0) {
+		return motion[id].getTarget();
+	}
+	return motion[id].evaluate(time);
+}
+
+const vector<int>& GameInstance::getInFlight() const {
+	return inFlight;
+}
+
+bool GameInstance::isInFlight(int id) const {
+	return flightIndex[id] >= 0;
+}
+
+bool GameInstance::isActive(int id) const {
+	return active[id];
+}
+
+int GameInstance::getHits() const {
+	return hits;
+}
+
+int GameInstance::getMisses() const {
+	return misses;
+}
+
+int GameInstance::getPopups() const {
+	return popups;
+}
+
+int GameInstance::getEscapes() const {
+	return escapes;
+}
+
+double GameInstance::getHitLatency() const {
+	return hitLatency;
+}
@@ -0,0 +1,125 @@
+#ifndef game_h
+#define game_h
+
+#include <stdio.h>
+#include <cstdint>
+#include <vector>
+#include "motion.h"
+#include "behaviour.h"
+
+using namespace std;
+
+// Tuning of a round of the game
+struct GameConfig {
+	// hamsters per side of the board, spaced one unit apart
+	int grid = 3;
+	double spacing = 1.0;
+
+	// hamster heights and durations of their motions [s]
+	double hamsterBottom = -0.8;
+	double hamsterTop = -0.2;
+	double hamsterRiseTime = 0.25;
+	double hamsterHideTime = 0.35;
+	double hamsterKnockTime = 0.12;
+
+	// mean waiting times of the random hamster transitions [s]
+	double hamsterHiddenTime = 1.8;
+	double hamsterStayTime = 0.9;
+	double hamsterRecoverTime = 3.6;
+};
+
+/*
+  Hamster states
+  0 = bottom
+  1 = upwards
+  2 = top
+  3 = downwards
+  4 = unconcious
+  5 = knocked out
+ */
+
+// State of one game: the hamster behaviours, their motions and the score.
+// Nothing here knows about graphics, audio or the device, so instances can be
+// driven by the haptic loop or simulated headless, each with its own random
+// generator.
+class GameInstance {
+	GameConfig config;
+	int count;
+
+	vector<int> state;
+	vector<Motion> motion;
+	vector<bool> active;
+	vector<double> popTime;
+
+	// ids of the hamsters in motion, in no order, and the index of each id in
+	// that list or -1 while it rests
+	vector<int> inFlight;
+	vector<int> flightIndex;
+
+	BehaviourScheduler behaviours;
+	vector<int> slots;
+
+	uint64_t rng;
+
+	int hits = 0;
+	int misses = 0;
+	int popups = 0;
+	int escapes = 0;
+	double hitLatency = 0.0;
+	bool raised = true;
+
+	void move(int id, double to, double duration, Easing easing);
+	// The motion of a hamster reached its end
+	void land(int id);
+
+	// life of a hamster: hide, pop up, stay, leave, and go down when hit
+	static Behaviour hamsterBehaviour(BehaviourScheduler& scheduler, GameInstance& game, int id);
+
+public:
+
+	GameInstance(const GameConfig& config = GameConfig(), uint64_t seed = 1);
+	// the behaviours refer to their instance, which therefore stays in place
+	GameInstance(const GameInstance&) = delete;
+	GameInstance& operator=(const GameInstance&) = delete;
+
+	// Starts a new round at the given time, scores are reset
+	void start(double time);
+	// Runs the hamster behaviours up to the given time
+	void advance(double time);
+
+	// The hammer was lifted and may score a miss again
+	void liftHammer();
+	// The hammer struck a hamster, returns true if it knocked it out
+	bool strikeHamster(int id);
+	// The hammer struck the board, a miss unless it is still down
+	void strikeBoard();
+
+	// Returns a uniform number in [0, 1) from the generator of this instance
+	double random();
+	// Draws a waiting time from an exponential distribution with the given mean
+	double randomExponential(double mean);
+
+	const GameConfig& getConfig() const;
+	int getNumHamsters() const;
+	// Position of a hamster on the board, centered on the origin
+	void getPosition(int id, double& x, double& y) const;
+	int getState(int id) const;
+	const Motion& getMotion(int id) const;
+	// Height of a hamster at the given time, evaluated from its motion
+	double getHeight(int id, double time) const;
+	// Hamsters whose motion has not ended yet, the only ones whose height changes
+	const vector<int>& getInFlight() const;
+	bool isInFlight(int id) const;
+	// False while the hamster rests under the board
+	bool isActive(int id) const;
+
+	int getHits() const;
+	int getMisses() const;
+	int getPopups() const;
+	// Hamsters that went back down without being hit
+	int getEscapes() const;
+	// Sum over the hits of the time since the hamster started rising [s]
+	double getHitLatency() const;
+};
+
+#endif
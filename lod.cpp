@@ -0,0 +1,442 @@
+#include "lod.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+
+static const char LOD_MAGIC[4] = { 'H', 'L', 'O', 'D' };
+// version 2 stores the measured displacement as the error of a level
+static const int32_t LOD_VERSION = 2;
+
+float clusterVertices(const LodMesh& source, const float origin[3], float cellSize, LodMesh& out) {
+	out.vertices.clear();
+	out.indices.clear();
+
+	// cell of every source vertex, and the running sum of each cell
+	int count = (int)source.vertices.size() / 3;
+	vector<uint32_t> remap(count);
+	vector<int> members;
+	unordered_map<long long, uint32_t> cells;
+	for (int v = 0; v < count; v++) {
+		long long key = 0;
+		for (int k = 0; k < 3; k++) {
+			long long cell = (long long)floorf((source.vertices[3 * v + k] - origin[k]) / cellSize);
+			key = key * 2097152 + (cell & 2097151);
+		}
+		auto inserted = cells.insert(make_pair(key, (uint32_t)members.size()));
+		if (inserted.second) {
+			members.push_back(0);
+			out.vertices.insert(out.vertices.end(), 3, 0.0f);
+		}
+		uint32_t c = inserted.first->second;
+		remap[v] = c;
+		members[c]++;
+		for (int k = 0; k < 3; k++) {
+			out.vertices[3 * c + k] += source.vertices[3 * v + k];
+		}
+	}
+	for (size_t c = 0; c < members.size(); c++) {
+		for (int k = 0; k < 3; k++) {
+			out.vertices[3 * c + k] /= members[c];
+		}
+	}
+
+	// a vertex and the mean of its cell can lie up to a cell diagonal apart,
+	// the largest actual move is the error of the level
+	float moved = 0.0f;
+	for (int v = 0; v < count; v++) {
+		float d2 = 0.0f;
+		for (int k = 0; k < 3; k++) {
+			float d = source.vertices[3 * v + k] - out.vertices[3 * remap[v] + k];
+			d2 += d * d;
+		}
+		moved = max(moved, d2);
+	}
+
+	unordered_set<unsigned long long> kept;
+	for (size_t t = 0; t + 2 < source.indices.size(); t += 3) {
+		uint32_t a = remap[source.indices[t]];
+		uint32_t b = remap[source.indices[t + 1]];
+		uint32_t c = remap[source.indices[t + 2]];
+		if (a == b || b == c || a == c) {
+			continue;
+		}
+		// the same corners in the same winding are one triangle
+		uint32_t first = min(a, min(b, c));
+		uint32_t second = first == a ? b : (first == b ? c : a);
+		uint32_t third = first == a ? c : (first == b ? a : b);
+		unsigned long long key = ((unsigned long long)first << 42) ^ ((unsigned long long)second << 21) ^ third;
+		if (!kept.insert(key).second) {
+			continue;
+		}
+		out.indices.push_back(a);
+		out.indices.push_back(b);
+		out.indices.push_back(c);
+	}
+	return sqrtf(moved);
+}
+
+uint64_t hashLodMeshes(const vector<LodMesh>& meshes) {
+	// FNV-1a over positions and indices
+	uint64_t hash = 14695981039346656037ULL;
+	for (const LodMesh& mesh : meshes) {
+		const unsigned char* bytes = (const unsigned char*)mesh.vertices.data();
+		for (size_t i = 0; i < mesh.vertices.size() * sizeof(float); i++) {
+			hash = (hash ^ bytes[i]) * 1099511628211ULL;
+		}
+		bytes = (const unsigned char*)mesh.indices.data();
+		for (size_t i = 0; i < mesh.indices.size() * sizeof(uint32_t); i++) {
+			hash = (hash ^ bytes[i]) * 1099511628211ULL;
+		}
+	}
+	return hash;
+}
+
+bool saveLodLevels(const string& path, uint64_t hash, const vector<LodLevel>& levels) {
+	ofstream file(path.c_str(), ios::binary);
+	if (!file) {
+		return false;
+	}
+	int32_t numLevels = (int32_t)levels.size();
+	file.write(LOD_MAGIC, 4);
+	file.write((const char*)&LOD_VERSION, sizeof(LOD_VERSION));
+	file.write((const char*)&hash, sizeof(hash));
+	file.write((const char*)&numLevels, sizeof(numLevels));
+	for (const LodLevel& level : levels) {
+		int32_t numMeshes = (int32_t)level.meshes.size();
+		file.write((const char*)&level.error, sizeof(level.error));
+		file.write((const char*)&numMeshes, sizeof(numMeshes));
+		for (const LodMesh& mesh : level.meshes) {
+			int32_t sizes[2] = { (int32_t)mesh.vertices.size(), (int32_t)mesh.indices.size() };
+			file.write((const char*)sizes, sizeof(sizes));
+			file.write((const char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(float));
+			file.write((const char*)mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+		}
+	}
+	return file.good();
+}
+
+bool loadLodLevels(const string& path, uint64_t hash, vector<LodLevel>& levels) {
+	ifstream file(path.c_str(), ios::binary);
+	if (!file) {
+		return false;
+	}
+
+	char magic[4];
+	int32_t version, numLevels;
+	uint64_t fileHash;
+	file.read(magic, 4);
+	file.read((char*)&version, sizeof(version));
+	file.read((char*)&fileHash, sizeof(fileHash));
+	file.read((char*)&numLevels, sizeof(numLevels));
+	if (!file || memcmp(magic, LOD_MAGIC, 4) != 0 || version != LOD_VERSION ||
+		fileHash != hash || numLevels < 0) {
+		return false;
+	}
+
+	levels.assign(numLevels, LodLevel());
+	for (LodLevel& level : levels) {
+		int32_t numMeshes;
+		file.read((char*)&level.error, sizeof(level.error));
+		file.read((char*)&numMeshes, sizeof(numMeshes));
+		if (!file || numMeshes < 0) {
+			levels.clear();
+			return false;
+		}
+		level.meshes.resize(numMeshes);
+		for (LodMesh& mesh : level.meshes) {
+			int32_t sizes[2];
+			file.read((char*)sizes, sizeof(sizes));
+			if (!file || sizes[0] < 0 || sizes[1] < 0) {
+				levels.clear();
+				return false;
+			}
+			mesh.vertices.resize(sizes[0]);
+			mesh.indices.resize(sizes[1]);
+			file.read((char*)mesh.vertices.data(), sizes[0] * sizeof(float));
+			file.read((char*)mesh.indices.data(), sizes[1] * sizeof(uint32_t));
+		}
+	}
+	if (!file) {
+		levels.clear();
+		return false;
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+void LodGroup::build(cMultiMesh* object, cGenericObject* parent, const string& cachePath, int tilesX, int tilesY, int numLevels, double finestCell) {
+	source = object;
+	root = new cGenericObject();
+	parent->addChild(root);
+	source->computeBoundaryBox(true);
+	cVector3d boundsMin = source->getBoundaryMin();
+	cVector3d boundsMax = source->getBoundaryMax();
+
+	// meshes of the object in its own frame
+	vector<LodMesh> meshes(source->getNumMeshes());
+	for (int m = 0; m < source->getNumMeshes(); m++) {
+		cMesh* mesh = source->getMesh(m);
+		cVector3d meshPos = mesh->getLocalPos();
+		cMatrix3d meshRot = mesh->getLocalRot();
+		for (int v = 0; v < mesh->getNumVertices(); v++) {
+			cVector3d p = meshPos + meshRot * mesh->m_vertices->getLocalPos(v);
+			meshes[m].vertices.push_back((float)p.x());
+			meshes[m].vertices.push_back((float)p.y());
+			meshes[m].vertices.push_back((float)p.z());
+		}
+		for (int t = 0; t < mesh->getNumTriangles(); t++) {
+			meshes[m].indices.push_back(mesh->m_triangles->getVertexIndex0(t));
+			meshes[m].indices.push_back(mesh->m_triangles->getVertexIndex1(t));
+			meshes[m].indices.push_back(mesh->m_triangles->getVertexIndex2(t));
+		}
+	}
+
+	uint64_t hash = hashLodMeshes(meshes);
+	vector<LodLevel> built;
+	if (!loadLodLevels(cachePath, hash, built) || (int)built.size() != numLevels) {
+		// the grid is anchored to the bounds so every level splits the same way
+		float origin[3] = { (float)boundsMin.x(), (float)boundsMin.y(), (float)boundsMin.z() };
+		double cell = finestCell * (boundsMax - boundsMin).length();
+		built.assign(numLevels, LodLevel());
+		for (int l = 0; l < numLevels; l++) {
+			built[l].error = 0.0f;
+			built[l].meshes.resize(meshes.size());
+			for (size_t m = 0; m < meshes.size(); m++) {
+				float moved = clusterVertices(meshes[m], origin, (float)cell, built[l].meshes[m]);
+				built[l].error = max(built[l].error, moved);
+			}
+			cell *= LEVEL_RATIO;
+		}
+		if (!saveLodLevels(cachePath, hash, built)) {
+			cout << "failed to write " << cachePath << endl;
+		}
+	}
+
+	// level 0 is the object itself, cut into the same tiles as the others
+	tiles.assign(tilesX * tilesY, Tile());
+	for (int t = 0; t < tilesX * tilesY; t++) {
+		tiles[t].boundsMin = boundsMax;
+		tiles[t].boundsMax = boundsMin;
+	}
+	errors.push_back(0.0);
+	addTiles(meshes, tilesX, tilesY, true);
+	for (const LodLevel& level : built) {
+		errors.push_back(level.error);
+		addTiles(level.meshes, tilesX, tilesY, false);
+	}
+
+	// tiles without any triangle are dropped
+	vector<Tile> kept;
+	for (Tile& tile : tiles) {
+		if (tile.levels[0] != NULL) {
+			kept.push_back(tile);
+		}
+	}
+	tiles.swap(kept);
+
+	// the tiles draw the object from now on
+	for (int m = 0; m < source->getNumMeshes(); m++) {
+		source->getMesh(m)->setShowEnabled(false, false);
+	}
+	for (Tile& tile : tiles) {
+		show(tile, 0);
+	}
+}
+
+void LodGroup::addTiles(const vector<LodMesh>& meshes, int tilesX, int tilesY, bool original) {
+	// the tile grid covers the bounds of the whole object in the board plane
+	cVector3d boundsMin = source->getBoundaryMin();
+	cVector3d boundsMax = source->getBoundaryMax();
+	double sizeX = cMax(boundsMax.x() - boundsMin.x(), 1e-9) / tilesX;
+	double sizeY = cMax(boundsMax.y() - boundsMin.y(), 1e-9) / tilesY;
+
+	vector<cMultiMesh*> objects(tiles.size(), NULL);
+	vector<uint32_t> remap;
+	for (size_t m = 0; m < meshes.size(); m++) {
+		const LodMesh& lod = meshes[m];
+		cMesh* sourceMesh = source->getMesh((int)m);
+		cMatrix3d sourceRot = sourceMesh->getLocalRot();
+		vector<cMesh*> tileMeshes(tiles.size(), NULL);
+		remap.assign(tiles.size() * (lod.vertices.size() / 3), UINT32_MAX);
+
+		for (size_t i = 0; i + 2 < lod.indices.size(); i += 3) {
+			const float* corners[3];
+			double cx = 0.0, cy = 0.0;
+			for (int c = 0; c < 3; c++) {
+				corners[c] = &lod.vertices[3 * lod.indices[i + c]];
+				cx += corners[c][0] / 3.0;
+				cy += corners[c][1] / 3.0;
+			}
+			// a triangle belongs to the tile of its centroid
+			int tx = cClamp((int)((cx - boundsMin.x()) / sizeX), 0, tilesX - 1);
+			int ty = cClamp((int)((cy - boundsMin.y()) / sizeY), 0, tilesY - 1);
+			int t = ty * tilesX + tx;
+
+			if (objects[t] == NULL) {
+				objects[t] = new cMultiMesh();
+			}
+			if (tileMeshes[t] == NULL) {
+				// same look as the mesh it simplifies, simplified levels have
+				// no texture coordinates and no colors to draw with
+				cMesh* mesh = objects[t]->newMesh();
+				mesh->setMaterial(sourceMesh->m_material);
+				mesh->setUseTransparency(sourceMesh->getUseTransparency());
+				mesh->setUseCulling(sourceMesh->getUseCulling());
+				if (original) {
+					mesh->setTexture(sourceMesh->m_texture);
+					mesh->setUseTexture(sourceMesh->getUseTexture());
+					mesh->setUseVertexColors(sourceMesh->getUseVertexColors());
+				}
+				tileMeshes[t] = mesh;
+			}
+
+			uint32_t ids[3];
+			for (int c = 0; c < 3; c++) {
+				uint32_t& id = remap[t * (lod.vertices.size() / 3) + lod.indices[i + c]];
+				if (id == UINT32_MAX) {
+					id = tileMeshes[t]->newVertex(corners[c][0], corners[c][1], corners[c][2]);
+					if (original) {
+						uint32_t v = lod.indices[i + c];
+						tileMeshes[t]->m_vertices->setNormal(id, sourceRot * sourceMesh->m_vertices->getNormal(v));
+						tileMeshes[t]->m_vertices->setTexCoord(id, sourceMesh->m_vertices->getTexCoord(v));
+						tileMeshes[t]->m_vertices->setColor(id, sourceMesh->m_vertices->getColor(v));
+					}
+				}
+				ids[c] = id;
+
+				// the finest level sets the bounds used to pick levels
+				if (tiles[t].levels.empty()) {
+					cVector3d p(corners[c][0], corners[c][1], corners[c][2]);
+					tiles[t].boundsMin = cVector3d(cMin(tiles[t].boundsMin.x(), p.x()), cMin(tiles[t].boundsMin.y(), p.y()), cMin(tiles[t].boundsMin.z(), p.z()));
+					tiles[t].boundsMax = cVector3d(cMax(tiles[t].boundsMax.x(), p.x()), cMax(tiles[t].boundsMax.y(), p.y()), cMax(tiles[t].boundsMax.z(), p.z()));
+				}
+			}
+			tileMeshes[t]->newTriangle(ids[0], ids[1], ids[2]);
+		}
+	}
+
+	for (size_t t = 0; t < tiles.size(); t++) {
+		cMultiMesh* object = objects[t];
+		if (object != NULL) {
+			// the original tiles keep the normals of the file
+			for (int m = 0; m < object->getNumMeshes() && !original; m++) {
+				object->getMesh(m)->computeAllNormals();
+			}
+			object->setUseDisplayList(true);
+			object->setHapticEnabled(false, true);
+			root->addChild(object);
+		}
+		tiles[t].levels.push_back(object);
+	}
+}
+
+void LodGroup::share(cMultiMesh* object, cGenericObject* parent, const LodGroup& other) {
+	source = object;
+	root = new cGenericObject();
+	parent->addChild(root);
+	errors = other.errors;
+	tiles = other.tiles;
+	for (Tile& tile : tiles) {
+		for (cMultiMesh*& level : tile.levels) {
+			if (level != NULL) {
+				level = level->copy(false, false, false, false);
+				level->setHapticEnabled(false, true);
+				root->addChild(level);
+			}
+		}
+		tile.current = -1;
+	}
+	for (int m = 0; m < source->getNumMeshes(); m++) {
+		source->getMesh(m)->setShowEnabled(false, false);
+	}
+	for (Tile& tile : tiles) {
+		show(tile, 0);
+	}
+}
+
+void LodGroup::update(cCamera* camera, int viewportHeight, double maxPixels) {
+	if (source == NULL || !visible) {
+		return;
+	}
+
+	// the tiles follow the pose the object was given for this frame
+	root->setLocalPos(source->getLocalPos());
+	root->setLocalRot(source->getLocalRot());
+
+	// eye in the frame of the object, which is never scaled
+	cVector3d eye = source->getLocalRot().getTranspose() * (camera->getLocalPos() - source->getLocalPos());
+	double p[3] = { eye.x(), eye.y(), eye.z() };
+	double angle = 0.5 * cDegToRad(camera->getFieldViewAngleDeg());
+	double pixelsPerUnitAtOne = 0.5 * viewportHeight / tan(angle);
+
+	for (Tile& tile : tiles) {
+		// distance from the eye to the nearest point of the tile
+		double lo[3] = { tile.boundsMin.x(), tile.boundsMin.y(), tile.boundsMin.z() };
+		double hi[3] = { tile.boundsMax.x(), tile.boundsMax.y(), tile.boundsMax.z() };
+		double d2 = 0.0;
+		for (int k = 0; k < 3; k++) {
+			double d = cMax(lo[k] - p[k], 0.0) + cMax(p[k] - hi[k], 0.0);
+			d2 += d * d;
+		}
+		double pixelsPerUnit = pixelsPerUnitAtOne / cMax(sqrt(d2), 1e-3);
+
+		// a coarser level has to fit with some margin so levels do not flicker
+		int level = 0;
+		for (int l = (int)errors.size() - 1; l > 0; l--) {
+			double budget = l > tile.current ? 0.8 * maxPixels : maxPixels;
+			if (tile.levels[l] != NULL && errors[l] * pixelsPerUnit <= budget) {
+				level = l;
+				break;
+			}
+		}
+		if (level != tile.current) {
+			show(tile, level);
+		}
+	}
+}
+
+void LodGroup::show(Tile& tile, int level) {
+	tile.current = level;
+	for (size_t l = 0; l < tile.levels.size(); l++) {
+		if (tile.levels[l] != NULL) {
+			tile.levels[l]->setShowEnabled((int)l == level, true);
+		}
+	}
+}
+
+void LodGroup::setVisible(bool v) {
+	if (v != visible && source != NULL) {
+		visible = v;
+		// a disabled node is skipped with all its children
+		root->setEnabled(visible, true);
+	}
+}
+
+int LodGroup::getNumLevels() const {
+	return (int)errors.size();
+}
+
+int LodGroup::getNumTiles() const {
+	return (int)tiles.size();
+}
+
+int LodGroup::getNumDrawnTriangles() const {
+	int count = 0;
+	if (visible) {
+		for (const Tile& tile : tiles) {
+			if (tile.current >= 0 && tile.levels[tile.current] != NULL) {
+				count += tile.levels[tile.current]->getNumTriangles();
+			}
+		}
+	}
+	return count;
+}
+
+bool LodGroup::isVisible() const {
+	return visible;
+}
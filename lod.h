@@ -0,0 +1,94 @@
+#ifndef lod_h
+#define lod_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "chai3d.h"
+
+using namespace chai3d;
+using namespace std;
+
+// Triangle mesh as flat arrays of xyz positions and vertex indices
+struct LodMesh {
+	vector<float> vertices;
+	vector<uint32_t> indices;
+};
+
+// One level of detail of an object: a simplified copy of each of its meshes
+// and the largest distance a vertex moved to build it
+struct LodLevel {
+	float error;
+	vector<LodMesh> meshes;
+};
+
+// Simplifies a mesh by merging all vertices inside each cell of a grid into
+// their mean, triangles that collapse or repeat are dropped. Returns the
+// largest distance a vertex moved.
+float clusterVertices(const LodMesh& source, const float origin[3], float cellSize, LodMesh& out);
+
+// Hash of the meshes of an object, used to validate the level cache
+uint64_t hashLodMeshes(const vector<LodMesh>& meshes);
+
+bool saveLodLevels(const string& path, uint64_t hash, const vector<LodLevel>& levels);
+// Reads cached levels, fails if they were built from a different object
+bool loadLodLevels(const string& path, uint64_t hash, vector<LodLevel>& levels);
+
+// Simplified copies of an object drawn in its place. The object is cut into
+// a grid of tiles over its bounds, and each tile draws the coarsest level
+// whose error stays under a pixel budget on screen, so far parts of a large
+// object simplify while near parts keep every triangle. Level 0 is the object
+// itself with its normals and materials. The tiles live under their own node
+// in a render-only branch that the haptic thread never walks. That node takes
+// the pose of the object at every update, and the object keeps its collision
+// data.
+class LodGroup {
+	struct Tile {
+		cVector3d boundsMin;
+		cVector3d boundsMax;
+		vector<cMultiMesh*> levels;
+		// drawn level, -1 before the first update
+		int current = -1;
+	};
+
+	cMultiMesh* source = NULL;
+	// parent of the tiles, posed like the source
+	cGenericObject* root = NULL;
+	vector<double> errors;
+	vector<Tile> tiles;
+	bool visible = true;
+
+	// original tiles copy the normals, texture coordinates and colors of the
+	// source vertices, simplified ones compute their normals
+	void addTiles(const vector<LodMesh>& meshes, int tilesX, int tilesY, bool original);
+	void show(Tile& tile, int level);
+
+public:
+
+	// Coarsening between two simplified levels
+	static const int LEVEL_RATIO = 2;
+
+	// Builds numLevels simplified levels of an object, the finest with cells
+	// of finestCell times its bounding box diagonal, on a grid of tiles added
+	// under parent, which has the same frame as the parent of the object. The
+	// levels are read from the cache file when it matches the object.
+	void build(cMultiMesh* object, cGenericObject* parent, const string& cachePath, int tilesX = 1, int tilesY = 1,
+		int numLevels = 5, double finestCell = 1.0 / 256.0);
+	// Shares the levels of another group built from the same meshes
+	void share(cMultiMesh* object, cGenericObject* parent, const LodGroup& other);
+
+	// Draws in each tile the coarsest level whose error projects to at most
+	// maxPixels
+	void update(cCamera* camera, int viewportHeight, double maxPixels);
+	// Takes the levels out of the render traversal or puts them back
+	void setVisible(bool visible);
+
+	int getNumLevels() const;
+	int getNumTiles() const;
+	// Triangles drawn at the current levels
+	int getNumDrawnTriangles() const;
+	bool isVisible() const;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#include "motion.h"
+
+Motion::Motion() {
+}
+
+Motion::Motion(double time, double a, double b, double length, Easing e) {
+	start(time, a, b, length, e);
+}
+
+void Motion::start(double time, double a, double b, double length, Easing e) {
+	startTime = time;
+	from = a;
+	to = b;
+	duration = length;
+	easing = e;
+}
+
+double Motion::evaluate(double time) const {
+	if (duration <= 0.0 || time >= startTime + duration) {
+		return to;
+	}
+	if (time <= startTime) {
+		return from;
+	}
+
+	double s = (time - startTime) / duration;
+	switch (easing) {
+	case EASE_IN:
+		s = s * s;
+		break;
+	case EASE_OUT:
+		s = s * (2.0 - s);
+		break;
+	case EASE_IN_OUT:
+		s = s * s * (3.0 - 2.0 * s);
+		break;
+	default:
+		break;
+	}
+	return from + (to - from) * s;
+}
+
+bool Motion::isFinished(double time) const {
+	return time >= startTime + duration;
+}
+
+double Motion::getTarget() const {
+	return to;
+}
+
+double Motion::getEndTime() const {
+	return startTime + duration;
+}
@@ -0,0 +1,40 @@
+#ifndef motion_h
+#define motion_h
+
+#include <stdio.h>
+
+// Easing curves that shape a motion between its start and end value
+enum Easing {
+	EASE_LINEAR,
+	EASE_IN,
+	EASE_OUT,
+	EASE_IN_OUT
+};
+
+// A one dimensional motion described as a curve in time. Nothing is stepped
+// per tick: the value is computed only when it is asked for at a timestamp.
+class Motion {
+	double startTime = 0.0;
+	double duration = 0.0;
+	double from = 0.0;
+	double to = 0.0;
+	Easing easing = EASE_LINEAR;
+
+public:
+
+	Motion();
+	Motion(double, double, double, double, Easing easing = EASE_IN_OUT);
+
+	// Starts a new curve at the given time going from one value to another
+	void start(double time, double from, double to, double duration, Easing easing = EASE_IN_OUT);
+	// Returns the value of the curve at the given time, held at both ends
+	double evaluate(double time) const;
+	// Returns true once the given time is past the end of the curve
+	bool isFinished(double time) const;
+
+	double getTarget() const;
+	double getEndTime() const;
+
+};
+
+#endif
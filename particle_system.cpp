@@ -0,0 +1,173 @@
+#include "particle_system.h"
+#include <map>
+
+ParticleSystem::ParticleSystem(double cellSize) : hash(cellSize) {
+}
+
+int ParticleSystem::addSphere(Sphere* sphere) {
+	spheres.push_back(sphere);
+	sphereIsland.push_back(-1);
+	return hash.add(sphere);
+}
+
+int ParticleSystem::addSpring(Spring* spring) {
+	springs.push_back(spring);
+	return (int)springs.size() - 1;
+}
+
+int ParticleSystem::findRoot(vector<int>& parent, int i) {
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+void ParticleSystem::buildIslands() {
+	map<Sphere*, int> index;
+	vector<int> parent(spheres.size());
+	for (int i = 0; i < (int)spheres.size(); i++) {
+		index[spheres[i]] = i;
+		parent[i] = i;
+	}
+
+	// Union the two ends of every spring
+	for (Spring* s : springs) {
+		int a = findRoot(parent, index[s->getSphereA()]);
+		int b = findRoot(parent, index[s->getSphereB()]);
+		parent[a] = b;
+	}
+
+	islands.clear();
+	vector<int> rootIsland(spheres.size(), -1);
+	for (int i = 0; i < (int)spheres.size(); i++) {
+		int root = findRoot(parent, i);
+		if (rootIsland[root] < 0) {
+			rootIsland[root] = (int)islands.size();
+			islands.push_back(Island());
+		}
+		sphereIsland[i] = rootIsland[root];
+		islands[sphereIsland[i]].spheres.push_back(i);
+	}
+	for (int s = 0; s < (int)springs.size(); s++) {
+		islands[sphereIsland[index[springs[s]->getSphereA()]]].springs.push_back(s);
+	}
+
+	candidates.reserve(spheres.size());
+	cursorSpheres.reserve(spheres.size());
+	awakeSpheres.reserve(spheres.size());
+}
+
+void ParticleSystem::wake(int island) {
+	islands[island].awake = true;
+	islands[island].quietSteps = 0;
+}
+
+cVector3d ParticleSystem::step(double time, cVector3d c_p, double c_r) {
+	// Wake the islands the cursor touches
+	cursorSpheres.clear();
+	hash.query(c_p, c_r, cursorSpheres);
+	for (int i : cursorSpheres) {
+		wake(sphereIsland[i]);
+	}
+
+	awakeSpheres.clear();
+	for (Island& island : islands) {
+		if (island.awake) {
+			awakeSpheres.insert(awakeSpheres.end(), island.spheres.begin(), island.spheres.end());
+		}
+	}
+
+	// Contacts of all awake spheres before any force is summed, so both sides
+	// of a contact land in the same step. An island touched by an awake
+	// sphere wakes and its spheres join the list, every pair is seen once.
+	for (size_t k = 0; k < awakeSpheres.size(); k++) {
+		int i = awakeSpheres[k];
+		candidates.clear();
+		hash.query(spheres[i]->getPosition(), spheres[i]->getRadius(), candidates);
+		for (int j : candidates) {
+			Island& other = islands[sphereIsland[j]];
+			if (!other.awake) {
+				wake(sphereIsland[j]);
+				awakeSpheres.insert(awakeSpheres.end(), other.spheres.begin(), other.spheres.end());
+			}
+			if (j > i) {
+				spheres[i]->calculateContact(spheres[j]);
+			}
+		}
+	}
+
+	// Springs of the awake islands
+	for (Island& island : islands) {
+		if (!island.awake) {
+			continue;
+		}
+		for (int s : island.springs) {
+			springs[s]->calculateForces();
+		}
+	}
+
+	// Cursor contact, only with the spheres it touches
+	cVector3d force(0, 0, 0);
+	for (int i : cursorSpheres) {
+		force += spheres[i]->calculateForces(c_p, c_r);
+	}
+
+	// Integrate the awake islands and put the still ones to sleep
+	for (Island& island : islands) {
+		if (!island.awake) {
+			continue;
+		}
+		double energy = 0.0;
+		for (int i : island.spheres) {
+			spheres[i]->updateSphere(time);
+			hash.update(i);
+			energy += 0.5 * spheres[i]->mass * spheres[i]->velocity.lengthsq();
+		}
+		for (int s : island.springs) {
+			springs[s]->updateSpring();
+		}
+
+		island.quietSteps = energy < sleepEnergy ? island.quietSteps + 1 : 0;
+		if (island.quietSteps >= sleepSteps) {
+			island.awake = false;
+			for (int i : island.spheres) {
+				spheres[i]->velocity.zero();
+			}
+		}
+	}
+	return force;
+}
+
+void ParticleSystem::applyForce(int sphere, cVector3d force) {
+	wake(sphereIsland[sphere]);
+	spheres[sphere]->addForce(force);
+}
+
+void ParticleSystem::wakeAll() {
+	for (int i = 0; i < (int)islands.size(); i++) {
+		wake(i);
+	}
+}
+
+Sphere* ParticleSystem::getSphere(int index) {
+	return spheres[index];
+}
+
+int ParticleSystem::getNumSpheres() {
+	return (int)spheres.size();
+}
+
+int ParticleSystem::getNumIslands() {
+	return (int)islands.size();
+}
+
+int ParticleSystem::getNumAwakeIslands() {
+	int awake = 0;
+	for (const Island& island : islands) {
+		if (island.awake) {
+			awake++;
+		}
+	}
+	return awake;
+}
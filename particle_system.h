@@ -0,0 +1,68 @@
+#ifndef particle_system_h
+#define particle_system_h
+
+#include <stdio.h>
+#include "chai3d.h"
+#include "sphere.h"
+#include "spring.h"
+#include "spatial_hash.h"
+#include <vector>
+
+using namespace chai3d;
+using namespace std;
+
+// Mass-spring bodies split into islands of spheres connected by springs. An
+// island whose kinetic energy stays below a threshold for a number of steps
+// goes to sleep: its springs, contacts and integration are skipped until the
+// cursor, a contact from an awake sphere or an external force wakes it up.
+class ParticleSystem {
+	struct Island {
+		vector<int> spheres;
+		vector<int> springs;
+		bool awake = true;
+		int quietSteps = 0;
+	};
+
+	vector<Sphere*> spheres;
+	vector<Spring*> springs;
+	// island of each sphere
+	vector<int> sphereIsland;
+	vector<Island> islands;
+	SpatialHash hash;
+
+	// scratch lists reused every step
+	vector<int> candidates;
+	vector<int> cursorSpheres;
+	vector<int> awakeSpheres;
+
+	int findRoot(vector<int>& parent, int i);
+	void wake(int island);
+
+public:
+
+	// kinetic energy under which an island counts as still [J]
+	double sleepEnergy = 1e-7;
+	// number of still steps before an island sleeps
+	int sleepSteps = 200;
+
+	ParticleSystem(double cellSize);
+
+	int addSphere(Sphere*);
+	int addSpring(Spring*);
+	// Groups spheres connected by springs into islands, call after adding
+	void buildIslands();
+
+	// Advances all awake islands, returns the force on the cursor
+	cVector3d step(double time, cVector3d c_p, double c_r);
+	// Applies an external force to a sphere and wakes its island
+	void applyForce(int sphere, cVector3d force);
+	void wakeAll();
+
+	Sphere* getSphere(int);
+	int getNumSpheres();
+	int getNumIslands();
+	int getNumAwakeIslands();
+
+};
+
+#endif
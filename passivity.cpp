@@ -0,0 +1,60 @@
+#include "passivity.h"
+
+PassivityController::PassivityController(double damping) {
+	maxDamping = damping;
+}
+
+cVector3d PassivityController::apply(const cVector3d& force, const cVector3d& velocity, double dt) {
+	ticks++;
+	damping = 0.0;
+
+	// Out of contact nothing is exchanged, and a new contact starts from zero
+	// so neither old credit nor an old debt carries over
+	if (force.lengthsq() == 0.0) {
+		energy = 0.0;
+		return force;
+	}
+
+	// The device pushes the user with force, so the environment absorbs the
+	// opposite of the power it delivers
+	energy -= force.dot(velocity) * dt;
+
+	double speed2 = velocity.lengthsq();
+	if (energy >= 0.0) {
+		return force;
+	}
+	if (speed2 < 1e-12 || dt <= 0.0) {
+		return force;
+	}
+
+	// damping that absorbs the whole debt over this tick, as much of it as
+	// the device can render, the rest is paid on the next ticks
+	damping = -energy / (dt * speed2);
+	if (maxDamping > 0.0 && damping > maxDamping) {
+		damping = maxDamping;
+	}
+	energy += damping * speed2 * dt;
+
+	dampedTicks++;
+	dissipated += damping * speed2 * dt;
+	peakDamping = damping > peakDamping ? damping : peakDamping;
+	return force - damping * velocity;
+}
+
+void PassivityController::reset() {
+	energy = 0.0;
+	damping = 0.0;
+}
+
+double PassivityController::getEnergy() const {
+	return energy;
+}
+
+double PassivityController::getDamping() const {
+	return damping;
+}
+
+void PassivityController::printSummary(ostream& out) {
+	out << "passivity: damping on " << (ticks > 0 ? 100.0 * dampedTicks / ticks : 0.0) << "% of " << ticks
+		<< " ticks, " << dissipated << " J dissipated, peak " << peakDamping << " N s/m" << endl;
+}
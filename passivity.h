@@ -0,0 +1,49 @@
+#ifndef passivity_h
+#define passivity_h
+
+#include <stdio.h>
+#include <iostream>
+#include "chai3d.h"
+
+using namespace chai3d;
+using namespace std;
+
+// Time domain passivity observer and controller on the force sent to a
+// device. The observer sums the energy the virtual environment absorbs from
+// the user every tick. When the sum turns negative the environment has
+// produced energy, from sampling a stiff contact or from an impulse, and the
+// controller adds just enough damping along the velocity to absorb it again.
+// The energy a contact stores, such as a compressed spring, is kept as credit
+// until the contact ends, so giving it back is not taken for a debt.
+class PassivityController {
+	// damping the device can render [N s/m], 0 leaves it unbounded
+	double maxDamping;
+
+	double energy = 0.0;
+	double damping = 0.0;
+
+	long long ticks = 0;
+	long long dampedTicks = 0;
+	double dissipated = 0.0;
+	double peakDamping = 0.0;
+
+public:
+
+	PassivityController(double maxDamping = 0.0);
+
+	// Returns the force to send for the force computed over a tick of dt
+	// seconds and the device velocity [m/s], both in the device frame
+	cVector3d apply(const cVector3d& force, const cVector3d& velocity, double dt);
+	// Forgets the energy of the current contact
+	void reset();
+
+	// Observed energy [J], negative while a debt is left to damp
+	double getEnergy() const;
+	// Damping added on the last tick [N s/m]
+	double getDamping() const;
+
+	// Logs how often and how much damping was needed
+	void printSummary(ostream& out);
+};
+
+#endif
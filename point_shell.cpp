@@ -0,0 +1,79 @@
+#include "point_shell.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+PointShell::PointShell(float r) {
+	radius = r;
+}
+
+void PointShell::addTriangle(const float a[3], const float b[3], const float c[3], float spacing) {
+	// Barycentric grid fine enough for the longest edge
+	float longest = 0.0f;
+	const float* corners[3] = { a, b, c };
+	for (int e = 0; e < 3; e++) {
+		const float* u = corners[e];
+		const float* v = corners[(e + 1) % 3];
+		float d2 = (u[0] - v[0]) * (u[0] - v[0]) + (u[1] - v[1]) * (u[1] - v[1]) + (u[2] - v[2]) * (u[2] - v[2]);
+		longest = max(longest, sqrtf(d2));
+	}
+	int steps = max(1, (int)ceilf(longest / spacing));
+
+	for (int i = 0; i <= steps; i++) {
+		for (int j = 0; i + j <= steps; j++) {
+			float u = (float)i / steps;
+			float v = (float)j / steps;
+			float w = 1.0f - u - v;
+			for (int k = 0; k < 3; k++) {
+				localPoints.push_back(w * a[k] + u * b[k] + v * c[k]);
+			}
+		}
+	}
+	worldPoints = localPoints;
+}
+
+void PointShell::weld(float spacing) {
+	// Keeps the first point that falls in each cell of a grid of spacing
+	unordered_map<long long, int> cells;
+	vector<float> kept;
+	for (size_t i = 0; i < localPoints.size(); i += 3) {
+		long long key = 0;
+		for (int k = 0; k < 3; k++) {
+			long long cell = (long long)floorf(localPoints[i + k] / spacing);
+			key = key * 2097152 + (cell & 2097151);
+		}
+		if (cells.insert(make_pair(key, (int)kept.size())).second) {
+			kept.insert(kept.end(), &localPoints[i], &localPoints[i] + 3);
+		}
+	}
+	localPoints.swap(kept);
+	worldPoints = localPoints;
+}
+
+void PointShell::clear() {
+	localPoints.clear();
+	worldPoints.clear();
+}
+
+void PointShell::transform(const float position[3], const float axisX[3], const float axisY[3], const float axisZ[3]) {
+	for (size_t i = 0; i < localPoints.size(); i += 3) {
+		float x = localPoints[i];
+		float y = localPoints[i + 1];
+		float z = localPoints[i + 2];
+		for (int k = 0; k < 3; k++) {
+			worldPoints[i + k] = position[k] + x * axisX[k] + y * axisY[k] + z * axisZ[k];
+		}
+	}
+}
+
+const float* PointShell::getPoints() const {
+	return worldPoints.data();
+}
+
+int PointShell::getNumPoints() const {
+	return (int)localPoints.size() / 3;
+}
+
+float PointShell::getRadius() const {
+	return radius;
+}
@@ -0,0 +1,38 @@
+#ifndef point_shell_h
+#define point_shell_h
+
+#include <stdio.h>
+#include <vector>
+
+using namespace std;
+
+// Surface of a rigid body sampled as small contact spheres. The points are
+// kept in the frame of the body and moved to its pose once per tick, so all
+// of them can be queried against a target in one batch.
+class PointShell {
+	float radius;
+	vector<float> localPoints;
+	vector<float> worldPoints;
+
+public:
+
+	PointShell(float radius = 0.03f);
+
+	// Samples a triangle with points no further apart than spacing
+	void addTriangle(const float a[3], const float b[3], const float c[3], float spacing);
+	// Keeps one point per cube of side spacing
+	void weld(float spacing);
+	void clear();
+
+	// Moves the points to a pose given by a position and the columns of a
+	// rotation matrix
+	void transform(const float position[3], const float axisX[3], const float axisY[3], const float axisZ[3]);
+
+	// Points at the last pose as xyz triples
+	const float* getPoints() const;
+	int getNumPoints() const;
+	float getRadius() const;
+
+};
+
+#endif
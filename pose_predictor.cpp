@@ -0,0 +1,85 @@
+#include "pose_predictor.h"
+
+PosePredictor::PosePredictor(int historySize, double horizon) {
+	size = cClamp(historySize, 2, MAX_HISTORY);
+	maxHorizon = horizon;
+}
+
+void PosePredictor::addSample(double time, const cVector3d& position, const cVector3d& velocity) {
+	if (count > 0 && time <= history[newest].time) {
+		return;
+	}
+	newest = (newest + 1) % size;
+	history[newest].time = time;
+	history[newest].position = position;
+	history[newest].velocity = velocity;
+	count = cMin(count + 1, size);
+}
+
+cVector3d PosePredictor::predict(double time) const {
+	if (count == 0) {
+		return cVector3d(0, 0, 0);
+	}
+	const Sample& last = history[newest];
+	double dt = cClamp(time - last.time, 0.0, maxHorizon);
+
+	// Acceleration over the whole history smooths out the velocity noise
+	cVector3d acceleration(0, 0, 0);
+	if (count > 1) {
+		const Sample& first = history[(newest - count + 1 + size) % size];
+		double span = last.time - first.time;
+		if (span > 0.0) {
+			acceleration = (last.velocity - first.velocity) / span;
+		}
+	}
+	return last.position + dt * last.velocity + (0.5 * dt * dt) * acceleration;
+}
+
+void PosePredictor::reset() {
+	count = 0;
+	newest = -1;
+}
+
+bool PosePredictor::isEmpty() const {
+	return count == 0;
+}
+
+double PosePredictor::getLatestTime() const {
+	return count > 0 ? history[newest].time : 0.0;
+}
+
+//------------------------------------------------------------------------------
+
+ScanoutClock::ScanoutClock(double delay) {
+	scanoutDelay = delay;
+}
+
+void ScanoutClock::swapped(double time) {
+	if (lastSwap >= 0.0) {
+		double interval = time - lastSwap;
+		if (interval > 0.5 * framePeriod && interval < 1.5 * framePeriod) {
+			framePeriod += 0.05 * (interval - framePeriod);
+			outliers = 0;
+		}
+		// Swaps that missed a refresh are not part of the period, unless the
+		// display really runs at another rate
+		else if (interval > 0.0 && ++outliers > 30) {
+			framePeriod = interval;
+			outliers = 0;
+		}
+	}
+	lastSwap = time;
+}
+
+double ScanoutClock::predict(double time) const {
+	if (lastSwap < 0.0) {
+		return time + (1.0 + scanoutDelay) * framePeriod;
+	}
+	// The frame is swapped at the first refresh that is still ahead
+	double frames = cMax(ceil((time - lastSwap) / framePeriod), 1.0);
+	return lastSwap + (frames + scanoutDelay) * framePeriod;
+}
+
+double ScanoutClock::getFramePeriod() const {
+	return framePeriod;
+}
@@ -0,0 +1,96 @@
+#ifndef pose_predictor_h
+#define pose_predictor_h
+
+#include <stdio.h>
+#include <atomic>
+#include "chai3d.h"
+
+using namespace chai3d;
+using namespace std;
+
+// Hands the latest value of one writer thread to a reader without locking.
+// The writer never waits, the reader retries while a write is in progress.
+template <typename T>
+class SeqLock {
+	atomic<unsigned> sequence;
+	T value;
+
+public:
+
+	SeqLock() : sequence(0), value() {}
+
+	void write(const T& v) {
+		unsigned s = sequence.load(memory_order_relaxed);
+		sequence.store(s + 1, memory_order_relaxed);
+		atomic_thread_fence(memory_order_release);
+		value = v;
+		atomic_thread_fence(memory_order_release);
+		sequence.store(s + 2, memory_order_relaxed);
+	}
+
+	void read(T& v) const {
+		unsigned before, after;
+		do {
+			before = sequence.load(memory_order_acquire);
+			v = value;
+			atomic_thread_fence(memory_order_acquire);
+			after = sequence.load(memory_order_relaxed);
+		} while ((before & 1) != 0 || before != after);
+	}
+};
+
+// Extrapolates a position to a future time from the latest sample, its
+// velocity and the acceleration seen over a short history of samples
+class PosePredictor {
+	static const int MAX_HISTORY = 16;
+
+	struct Sample {
+		double time;
+		cVector3d position;
+		cVector3d velocity;
+	};
+
+	Sample history[MAX_HISTORY];
+	int size;
+	int count = 0;
+	int newest = -1;
+	double maxHorizon;
+
+public:
+
+	PosePredictor(int historySize = 8, double maxHorizon = 0.05);
+
+	// Adds a timestamped sample, samples older than the newest are ignored
+	void addSample(double time, const cVector3d& position, const cVector3d& velocity);
+	// Returns the position expected at the given time, at most maxHorizon
+	// past the newest sample
+	cVector3d predict(double time) const;
+	void reset();
+
+	bool isEmpty() const;
+	double getLatestTime() const;
+};
+
+// Predicts when the frame being rendered reaches the screen from the
+// timestamps at which the buffer swaps return
+class ScanoutClock {
+	double scanoutDelay;
+	double framePeriod = 1.0 / 60.0;
+	double lastSwap = -1.0;
+	int outliers = 0;
+
+public:
+
+	// scanoutDelay is the delay from the refresh that shows a frame to the
+	// scan-out of its middle line, in refresh periods
+	ScanoutClock(double scanoutDelay = 0.5);
+
+	// Records the time at which a buffer swap returned
+	void swapped(double time);
+	// Returns the predicted scan-out time of the frame rendered now
+	double predict(double time) const;
+
+	double getFramePeriod() const;
+};
+
+#endif
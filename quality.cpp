@@ -0,0 +1,81 @@
+#include "quality.h"
+
+QualityController::QualityController(double targetPeriod, int levels, double budgetFraction, double headroomFraction) : level(0) {
+	period = targetPeriod;
+	numLevels = levels < 1 ? 1 : (levels > MAX_LEVELS ? MAX_LEVELS : levels);
+	budget = budgetFraction * period;
+	headroom = headroomFraction * period;
+	// one second of calm ticks by default
+	minRecoverTicks = (int)(1.0 / period);
+	recoverTicks = minRecoverTicks;
+	for (int i = 0; i < MAX_LEVELS; i++) {
+		ticksAtLevel[i] = 0;
+		enabled[i] = true;
+	}
+}
+
+int QualityController::update(double cost) {
+	int current = level.load(memory_order_relaxed);
+	ticks++;
+	ticksAtLevel[current]++;
+	ticksSinceChange++;
+
+	overruns = cost > budget ? overruns + 1 : 0;
+	calmTicks = cost < headroom ? calmTicks + 1 : 0;
+
+	int lower = current + 1;
+	while (lower < numLevels && !enabled[lower]) {
+		lower++;
+	}
+	int higher = current - 1;
+	while (higher > 0 && !enabled[higher]) {
+		higher--;
+	}
+
+	if (overruns >= degradeTicks && lower < numLevels) {
+		// Back off longer when the last recovery did not hold
+		if (recovered && ticksSinceChange < recoverTicks) {
+			recoverTicks = recoverTicks * 2 < maxRecoverTicks ? recoverTicks * 2 : maxRecoverTicks;
+		}
+		current = lower;
+		degrades++;
+		recovered = false;
+		overruns = 0;
+		calmTicks = 0;
+		ticksSinceChange = 0;
+	}
+	else if (calmTicks >= recoverTicks && higher >= 0) {
+		// A recovery that held as long again resets the back off
+		if (ticksSinceChange >= 2 * recoverTicks) {
+			recoverTicks = minRecoverTicks;
+		}
+		current = higher;
+		recovered = true;
+		calmTicks = 0;
+		ticksSinceChange = 0;
+	}
+	level.store(current, memory_order_relaxed);
+	return current;
+}
+
+void QualityController::setLevelEnabled(int l, bool e) {
+	if (l > 0 && l < MAX_LEVELS) {
+		enabled[l] = e;
+	}
+}
+
+int QualityController::getLevel() const {
+	return level.load(memory_order_relaxed);
+}
+
+int QualityController::getNumLevels() const {
+	return numLevels;
+}
+
+void QualityController::printSummary(ostream& out) {
+	out << "quality: " << degrades << " degradations over " << ticks << " ticks";
+	for (int i = 0; i < numLevels; i++) {
+		out << ", level " << i << " " << (ticks > 0 ? 100.0 * ticksAtLevel[i] / ticks : 0.0) << "%";
+	}
+	out << endl;
+}
@@ -0,0 +1,59 @@
+#ifndef quality_h
+#define quality_h
+
+#include <stdio.h>
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+
+// Steps a periodic loop through quality levels from the measured cost of its
+// ticks. Level 0 is full quality, every higher level is cheaper. A few ticks
+// over budget degrade by one level, a long run with headroom recovers one.
+class QualityController {
+	static const int MAX_LEVELS = 8;
+
+	double period;
+	int numLevels;
+	atomic<int> level;
+
+	// cost above which a tick overruns, and below which it leaves headroom [s]
+	double budget;
+	double headroom;
+
+	int overruns = 0;
+	int calmTicks = 0;
+	int recoverTicks;
+	int minRecoverTicks;
+	long long ticksSinceChange = 0;
+	bool recovered = false;
+
+	// levels that would save nothing in the current setup are stepped over
+	bool enabled[MAX_LEVELS];
+
+	long long ticks = 0;
+	long long ticksAtLevel[MAX_LEVELS];
+	long long degrades = 0;
+
+public:
+
+	// Consecutive overruns before degrading
+	int degradeTicks = 5;
+	// Longest wait before recovering, the wait doubles after every recovery
+	// that had to be undone right away
+	int maxRecoverTicks = 64000;
+
+	QualityController(double targetPeriod, int numLevels, double budget = 0.8, double headroom = 0.4);
+
+	// Records the cost of one tick [s] and returns the level for the next one
+	int update(double cost);
+	// Skips a level when degrading and recovering, level 0 always stays
+	void setLevelEnabled(int level, bool enabled);
+	int getLevel() const;
+	int getNumLevels() const;
+
+	// Logs how long the loop spent at each level
+	void printSummary(ostream& out);
+};
+
+#endif
@@ -0,0 +1,312 @@
+#include "realtime.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+#if defined(__linux__)
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#endif
+
+//------------------------------------------------------------------------------
+// Allocation tracking
+//------------------------------------------------------------------------------
+
+static thread_local bool allocationGuard = false;
+static atomic<long long> guardedAllocations(0);
+
+// alignment malloc already guarantees
+#if defined(__cpp_aligned_new)
+static const size_t defaultAlignment = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+#else
+static const size_t defaultAlignment = alignof(max_align_t);
+#endif
+
+static void* allocate(size_t size, size_t alignment) {
+	if (allocationGuard) {
+		guardedAllocations++;
+	}
+	if (size == 0) {
+		size = 1;
+	}
+	void* p;
+#if defined(_WIN32)
+	p = alignment > defaultAlignment ? _aligned_malloc(size, alignment) : malloc(size);
+#else
+	if (alignment > defaultAlignment) {
+		if (posix_memalign(&p, alignment, size) != 0) {
+			p = NULL;
+		}
+	}
+	else {
+		p = malloc(size);
+	}
+#endif
+	return p;
+}
+
+static void release(void* p, size_t alignment) {
+#if defined(_WIN32)
+	if (alignment > defaultAlignment) {
+		_aligned_free(p);
+		return;
+	}
+#endif
+	(void)alignment;
+	free(p);
+}
+
+static void* allocateOrThrow(size_t size, size_t alignment) {
+	void* p = allocate(size, alignment);
+	if (p == NULL) {
+		throw bad_alloc();
+	}
+	return p;
+}
+
+// every form of new and delete goes through the guard, so arrays and
+// over-aligned objects are counted too
+void* operator new(size_t size) {
+	return allocateOrThrow(size, defaultAlignment);
+}
+
+void* operator new[](size_t size) {
+	return allocateOrThrow(size, defaultAlignment);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+	return allocate(size, defaultAlignment);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+	return allocate(size, defaultAlignment);
+}
+
+void operator delete(void* p) noexcept {
+	release(p, defaultAlignment);
+}
+
+void operator delete[](void* p) noexcept {
+	release(p, defaultAlignment);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	release(p, defaultAlignment);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+	release(p, defaultAlignment);
+}
+
+void operator delete(void* p, const nothrow_t&) noexcept {
+	release(p, defaultAlignment);
+}
+
+void operator delete[](void* p, const nothrow_t&) noexcept {
+	release(p, defaultAlignment);
+}
+
+#if defined(__cpp_aligned_new)
+void* operator new(size_t size, align_val_t alignment) {
+	return allocateOrThrow(size, (size_t)alignment);
+}
+
+void* operator new[](size_t size, align_val_t alignment) {
+	return allocateOrThrow(size, (size_t)alignment);
+}
+
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+	return allocate(size, (size_t)alignment);
+}
+
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+	return allocate(size, (size_t)alignment);
+}
+
+void operator delete(void* p, align_val_t alignment) noexcept {
+	release(p, (size_t)alignment);
+}
+
+void operator delete[](void* p, align_val_t alignment) noexcept {
+	release(p, (size_t)alignment);
+}
+
+void operator delete(void* p, size_t, align_val_t alignment) noexcept {
+	release(p, (size_t)alignment);
+}
+
+void operator delete[](void* p, size_t, align_val_t alignment) noexcept {
+	release(p, (size_t)alignment);
+}
+
+void operator delete(void* p, align_val_t alignment, const nothrow_t&) noexcept {
+	release(p, (size_t)alignment);
+}
+
+void operator delete[](void* p, align_val_t alignment, const nothrow_t&) noexcept {
+	release(p, (size_t)alignment);
+}
+#endif
+
+void setAllocationGuard(bool enabled) {
+	allocationGuard = enabled;
+}
+
+long long getGuardedAllocations() {
+	return guardedAllocations.load();
+}
+
+//------------------------------------------------------------------------------
+// Thread setup
+//------------------------------------------------------------------------------
+
+bool lockMemory() {
+#if defined(__linux__)
+	// Keep freed memory in the process so later allocations do not fault
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+		cout << "realtime: mlockall failed: " << strerror(errno) << endl;
+		return false;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool enableRealtime(int core, int priority) {
+#if defined(__linux__)
+	bool ok = true;
+
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(core, &cpus);
+	int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	if (err != 0) {
+		cout << "realtime: cannot pin thread to core " << core << ": " << strerror(err) << endl;
+		ok = false;
+	}
+
+	sched_param param;
+	param.sched_priority = priority;
+	err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+	if (err != 0) {
+		cout << "realtime: cannot switch to SCHED_FIFO: " << strerror(err) << endl;
+		ok = false;
+	}
+	return ok;
+#else
+	return false;
+#endif
+}
+
+void prefaultStack(size_t bytes) {
+#if defined(__linux__)
+	volatile char* stack = (volatile char*)alloca(bytes);
+	for (size_t i = 0; i < bytes; i += 4096) {
+		stack[i] = 0;
+	}
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Jitter monitor
+//------------------------------------------------------------------------------
+
+JitterMonitor::JitterMonitor(double targetPeriod, double maxInterval) : written(0) {
+	period = targetPeriod;
+	deadline = maxInterval;
+	for (int k = 0; k < MISS_LOG; k++) {
+		missLog[k].sequence.store(-1, memory_order_relaxed);
+	}
+}
+
+void JitterMonitor::tick(double time) {
+	if (last < 0.0) {
+		last = time;
+		return;
+	}
+	double interval = time - last;
+	last = time;
+	ticks++;
+
+	double jitter = interval > period ? interval - period : period - interval;
+	sumJitter += jitter;
+	if (jitter > maxJitter) {
+		maxJitter = jitter;
+	}
+
+	if (interval > deadline) {
+		misses++;
+		// Only the owning thread writes, the oldest entries are overwritten.
+		// The entry is marked while it is written so a reader can tell.
+		long long w = written.load(memory_order_relaxed);
+		Miss& m = missLog[w % MISS_LOG];
+		m.sequence.store(-1, memory_order_relaxed);
+		atomic_thread_fence(memory_order_release);
+		m.tick = ticks;
+		m.time = time;
+		m.interval = interval;
+		m.allocations = getGuardedAllocations();
+		atomic_thread_fence(memory_order_release);
+		m.sequence.store(w, memory_order_relaxed);
+		written.store(w + 1, memory_order_release);
+	}
+}
+
+void JitterMonitor::printMisses(ostream& out) {
+	long long w = written.load(memory_order_acquire);
+	if (w - read > MISS_LOG) {
+		out << "realtime: " << (w - read - MISS_LOG) << " deadline misses not logged" << endl;
+		read = w - MISS_LOG;
+	}
+	for (; read < w; read++) {
+		// copy the entry, and drop it if the writer lapped the ring meanwhile
+		const Miss& entry = missLog[read % MISS_LOG];
+		long long before = entry.sequence.load(memory_order_acquire);
+		Miss m;
+		m.tick = entry.tick;
+		m.time = entry.time;
+		m.interval = entry.interval;
+		m.allocations = entry.allocations;
+		atomic_thread_fence(memory_order_acquire);
+		long long after = entry.sequence.load(memory_order_relaxed);
+		if (before != read || after != read) {
+			out << "realtime: deadline miss " << read << " overwritten before it was logged" << endl;
+			continue;
+		}
+		out << "realtime: deadline miss at tick " << m.tick
+			<< " t=" << m.time << " s"
+			<< " interval=" << m.interval * 1e6 << " us"
+			<< " (deadline " << deadline * 1e6 << " us)"
+			<< " allocations=" << m.allocations << endl;
+	}
+}
+
+void JitterMonitor::printSummary(ostream& out) {
+	out << "realtime: " << ticks << " ticks, mean jitter " << getMeanJitter() * 1e6
+		<< " us, max jitter " << maxJitter * 1e6 << " us, "
+		<< misses << " deadline misses, "
+		<< getGuardedAllocations() << " allocations on the haptic path" << endl;
+}
+
+double JitterMonitor::getMeanJitter() const {
+	return ticks > 0 ? sumJitter / ticks : 0.0;
+}
+
+double JitterMonitor::getMaxJitter() const {
+	return maxJitter;
+}
+
+long long JitterMonitor::getNumMisses() const {
+	return misses;
+}
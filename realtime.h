@@ -0,0 +1,68 @@
+#ifndef realtime_h
+#define realtime_h
+
+#include <stdio.h>
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+
+// Real-time setup of the haptic thread. Only implemented on Linux, on other
+// platforms every call reports failure and the generic thread priority applies.
+
+// Locks all current and future pages of the process in memory
+bool lockMemory();
+// Pins the calling thread to one core and switches it to SCHED_FIFO
+bool enableRealtime(int core, int priority = 80);
+// Touches the given amount of stack so its page faults happen now
+void prefaultStack(size_t bytes);
+
+// Counts heap allocations made by the calling thread while the guard is on
+void setAllocationGuard(bool enabled);
+long long getGuardedAllocations();
+
+// Tracks the tick to tick jitter of a periodic loop and keeps the context of
+// deadline misses in a ring that another thread drains for logging
+class JitterMonitor {
+	static const int MISS_LOG = 32;
+
+	struct Miss {
+		// number of the miss held, -1 while it is written
+		atomic<long long> sequence;
+		long long tick;
+		double time;
+		double interval;
+		long long allocations;
+	};
+
+	double period;
+	double deadline;
+	double last = -1.0;
+
+	long long ticks = 0;
+	long long misses = 0;
+	double sumJitter = 0.0;
+	double maxJitter = 0.0;
+
+	Miss missLog[MISS_LOG];
+	atomic<long long> written;
+	long long read = 0;
+
+public:
+
+	JitterMonitor(double targetPeriod, double maxInterval);
+
+	// Records a tick of the loop at the given time [s]
+	void tick(double time);
+	// Logs the deadline misses recorded since the last call
+	void printMisses(ostream& out);
+	// Logs a summary of the jitter measured so far
+	void printSummary(ostream& out);
+
+	double getMeanJitter() const;
+	double getMaxJitter() const;
+	long long getNumMisses() const;
+
+};
+
+#endif
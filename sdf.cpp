@@ -0,0 +1,206 @@
+#include "sdf.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+static const char SDF_MAGIC[4] = { 'H', 'S', 'D', 'F' };
+static const int32_t SDF_VERSION = 1;
+
+DistanceField::DistanceField() {
+	for (int k = 0; k < 3; k++) {
+		origin[k] = 0.0f;
+		bricks[k] = 0;
+	}
+}
+
+float DistanceField::signedDistance(const FlatBVH& bvh, const float p[3]) const {
+	BVHHit hit;
+	if (!bvh.closestPoint(p, band, hit)) {
+		return band;
+	}
+	// The side of the closest face gives the sign
+	return hit.distance;
+}
+
+void DistanceField::bake(const FlatBVH& bvh, float cellSize, float bandWidth) {
+	cell = cellSize;
+	band = bandWidth;
+	sourceHash = bvh.getHash();
+
+	float lo[3], hi[3];
+	bvh.getBounds(lo, hi);
+	float brickSize = BRICK * cell;
+	for (int k = 0; k < 3; k++) {
+		origin[k] = lo[k] - band;
+		bricks[k] = (int)ceilf((hi[k] - lo[k] + 2.0f * band) / brickSize);
+	}
+
+	brickIndex.assign((size_t)bricks[0] * bricks[1] * bricks[2], -1);
+	samples.clear();
+
+	// A brick is kept when the surface passes within the band of any of its samples
+	float halfDiagonal = 0.5f * sqrtf(3.0f) * brickSize;
+	int stored = 0;
+	for (int bz = 0; bz < bricks[2]; bz++) {
+		for (int by = 0; by < bricks[1]; by++) {
+			for (int bx = 0; bx < bricks[0]; bx++) {
+				float corner[3] = { origin[0] + bx * brickSize, origin[1] + by * brickSize, origin[2] + bz * brickSize };
+				float center[3] = { corner[0] + 0.5f * brickSize, corner[1] + 0.5f * brickSize, corner[2] + 0.5f * brickSize };
+				BVHHit hit;
+				if (!bvh.closestPoint(center, band + halfDiagonal, hit)) {
+					continue;
+				}
+
+				brickIndex[((size_t)bz * bricks[1] + by) * bricks[0] + bx] = stored++;
+				for (int z = 0; z < SAMPLES; z++) {
+					for (int y = 0; y < SAMPLES; y++) {
+						for (int x = 0; x < SAMPLES; x++) {
+							float p[3] = { corner[0] + x * cell, corner[1] + y * cell, corner[2] + z * cell };
+							float d = signedDistance(bvh, p) / band;
+							d = d < -1.0f ? -1.0f : (d > 1.0f ? 1.0f : d);
+							samples.push_back((int16_t)lrintf(d * 32767.0f));
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+bool DistanceField::query(const float p[3], float& distance, float gradient[3]) const {
+	int c[3];
+	float f[3];
+	for (int k = 0; k < 3; k++) {
+		float g = (p[k] - origin[k]) / cell;
+		c[k] = (int)floorf(g);
+		if (c[k] < 0 || c[k] >= bricks[k] * BRICK) {
+			return false;
+		}
+		f[k] = g - c[k];
+	}
+
+	int b[3] = { c[0] / BRICK, c[1] / BRICK, c[2] / BRICK };
+	int32_t index = brickIndex[((size_t)b[2] * bricks[1] + b[1]) * bricks[0] + b[0]];
+	if (index < 0) {
+		return false;
+	}
+
+	// Corner samples of the cell, bricks store their shared faces so no
+	// lookup ever crosses into a neighbour
+	const int16_t* s = &samples[(size_t)index * BRICK_SAMPLES];
+	int x = c[0] - b[0] * BRICK;
+	int y = c[1] - b[1] * BRICK;
+	int z = c[2] - b[2] * BRICK;
+	const int16_t* s0 = s + (z * SAMPLES + y) * SAMPLES + x;
+	const int16_t* s1 = s0 + SAMPLES * SAMPLES;
+	float d000 = s0[0], d100 = s0[1], d010 = s0[SAMPLES], d110 = s0[SAMPLES + 1];
+	float d001 = s1[0], d101 = s1[1], d011 = s1[SAMPLES], d111 = s1[SAMPLES + 1];
+
+	float d00 = d000 + (d100 - d000) * f[0];
+	float d10 = d010 + (d110 - d010) * f[0];
+	float d01 = d001 + (d101 - d001) * f[0];
+	float d11 = d011 + (d111 - d011) * f[0];
+	float d0 = d00 + (d10 - d00) * f[1];
+	float d1 = d01 + (d11 - d01) * f[1];
+
+	float scale = band / 32767.0f;
+	distance = (d0 + (d1 - d0) * f[2]) * scale;
+
+	// Derivatives of the trilinear interpolant
+	float gx0 = (d100 - d000) + ((d110 - d010) - (d100 - d000)) * f[1];
+	float gx1 = (d101 - d001) + ((d111 - d011) - (d101 - d001)) * f[1];
+	gradient[0] = (gx0 + (gx1 - gx0) * f[2]) * scale / cell;
+	gradient[1] = ((d10 - d00) + ((d11 - d01) - (d10 - d00)) * f[2]) * scale / cell;
+	gradient[2] = (d1 - d0) * scale / cell;
+	return true;
+}
+
+bool DistanceField::save(const string& path) const {
+	ofstream file(path.c_str(), ios::binary);
+	if (!file) {
+		return false;
+	}
+	int32_t count = (int32_t)brickIndex.size();
+	file.write(SDF_MAGIC, 4);
+	file.write((const char*)&SDF_VERSION, sizeof(SDF_VERSION));
+	file.write((const char*)&sourceHash, sizeof(sourceHash));
+	file.write((const char*)&cell, sizeof(cell));
+	file.write((const char*)&band, sizeof(band));
+	file.write((const char*)origin, sizeof(origin));
+	file.write((const char*)bricks, sizeof(bricks));
+	file.write((const char*)&count, sizeof(count));
+	file.write((const char*)brickIndex.data(), brickIndex.size() * sizeof(int32_t));
+	int32_t stored = getNumBricks();
+	file.write((const char*)&stored, sizeof(stored));
+	file.write((const char*)samples.data(), samples.size() * sizeof(int16_t));
+	return file.good();
+}
+
+bool DistanceField::load(const string& path, uint64_t hash, float cellSize, float bandWidth) {
+	ifstream file(path.c_str(), ios::binary);
+	if (!file) {
+		return false;
+	}
+
+	char magic[4];
+	int32_t version;
+	uint64_t fileHash;
+	float fileCell, fileBand;
+	file.read(magic, 4);
+	file.read((char*)&version, sizeof(version));
+	file.read((char*)&fileHash, sizeof(fileHash));
+	file.read((char*)&fileCell, sizeof(fileCell));
+	file.read((char*)&fileBand, sizeof(fileBand));
+	if (!file.good() || memcmp(magic, SDF_MAGIC, 4) != 0 || version != SDF_VERSION ||
+		fileHash != hash || fileCell != cellSize || fileBand != bandWidth) {
+		return false;
+	}
+
+	// a bad cache fails here and is baked again, so query never reads past
+	// the stored bricks
+	int32_t count, stored;
+	file.read((char*)origin, sizeof(origin));
+	file.read((char*)bricks, sizeof(bricks));
+	file.read((char*)&count, sizeof(count));
+	if (!file.good() || bricks[0] <= 0 || bricks[1] <= 0 || bricks[2] <= 0 ||
+		(int64_t)count != (int64_t)bricks[0] * bricks[1] * bricks[2]) {
+		return false;
+	}
+	brickIndex.resize(count);
+	file.read((char*)brickIndex.data(), count * sizeof(int32_t));
+	file.read((char*)&stored, sizeof(stored));
+	if (!file.good() || stored < 0 || stored > count) {
+		brickIndex.clear();
+		return false;
+	}
+	for (int32_t index : brickIndex) {
+		if (index < -1 || index >= stored) {
+			brickIndex.clear();
+			return false;
+		}
+	}
+	samples.resize((size_t)stored * BRICK_SAMPLES);
+	file.read((char*)samples.data(), samples.size() * sizeof(int16_t));
+	if (!file.good()) {
+		brickIndex.clear();
+		samples.clear();
+		return false;
+	}
+
+	sourceHash = fileHash;
+	cell = fileCell;
+	band = fileBand;
+	return true;
+}
+
+bool DistanceField::isEmpty() const {
+	return brickIndex.empty();
+}
+
+int DistanceField::getNumBricks() const {
+	return (int)(samples.size() / BRICK_SAMPLES);
+}
+
+size_t DistanceField::getMemorySize() const {
+	return brickIndex.size() * sizeof(int32_t) + samples.size() * sizeof(int16_t);
+}
@@ -0,0 +1,55 @@
+#ifndef sdf_h
+#define sdf_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "bvh.h"
+
+using namespace std;
+
+// Narrow band signed distance field baked from a triangle mesh. Space is split
+// into bricks of 8x8x8 cells and only the bricks near the surface store their
+// samples, so a lookup is one table read plus a trilinear interpolation no
+// matter how detailed the mesh is. Distances are negative behind the faces.
+class DistanceField {
+	static const int BRICK = 8;
+	static const int SAMPLES = BRICK + 1;
+	static const int BRICK_SAMPLES = SAMPLES * SAMPLES * SAMPLES;
+
+	float origin[3];
+	float cell = 0.0f;
+	float band = 0.0f;
+	// number of bricks along each axis
+	int bricks[3];
+	// index of the stored brick of each grid brick, -1 outside the band
+	vector<int32_t> brickIndex;
+	// distances of the stored bricks quantized to the band width
+	vector<int16_t> samples;
+	// hash of the mesh the field was baked from
+	uint64_t sourceHash = 0;
+
+	float signedDistance(const FlatBVH& bvh, const float p[3]) const;
+
+public:
+
+	DistanceField();
+
+	// Bakes the field of a mesh with the given cell size and band half width
+	void bake(const FlatBVH& bvh, float cellSize, float bandWidth);
+	// Writes the field to a cache file
+	bool save(const string& path) const;
+	// Reads a cache file, fails if it was baked from a different mesh or grid
+	bool load(const string& path, uint64_t hash, float cellSize, float bandWidth);
+
+	// Interpolates the distance and its gradient at p, returns false outside the band
+	bool query(const float p[3], float& distance, float gradient[3]) const;
+
+	bool isEmpty() const;
+	int getNumBricks() const;
+	size_t getMemorySize() const;
+
+};
+
+#endif
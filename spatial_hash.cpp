@@ -0,0 +1,157 @@
+#include "spatial_hash.h"
+
+// Bits per packed cell coordinate, cells wrap beyond +-2^20
+static const int CELL_BITS = 21;
+static const long long CELL_MASK = (1LL << CELL_BITS) - 1;
+
+static long long packCell(long long x, long long y, long long z) {
+	return ((x & CELL_MASK) << (2 * CELL_BITS)) | ((y & CELL_MASK) << CELL_BITS) | (z & CELL_MASK);
+}
+
+SpatialHash::SpatialHash(double size, int tableSize) {
+	cellSize = size;
+	// Round the table up to a power of two
+	int n = 1;
+	while (n < tableSize) {
+		n <<= 1;
+	}
+	tableMask = n - 1;
+	heads.assign(n, -1);
+}
+
+long long SpatialHash::cellOf(const cVector3d& p) const {
+	return packCell((long long)floor(p.x() / cellSize),
+		(long long)floor(p.y() / cellSize),
+		(long long)floor(p.z() / cellSize));
+}
+
+int SpatialHash::bucketOf(long long cell) const {
+	unsigned long long h = (unsigned long long)cell * 0x9E3779B97F4A7C15ULL;
+	return (int)(h >> 40) & tableMask;
+}
+
+void SpatialHash::link(int index, long long cell) {
+	int bucket = bucketOf(cell);
+	cells[index] = cell;
+	prev[index] = -1;
+	next[index] = heads[bucket];
+	if (next[index] >= 0) {
+		prev[next[index]] = index;
+	}
+	heads[bucket] = index;
+}
+
+void SpatialHash::unlink(int index) {
+	if (prev[index] >= 0) {
+		next[prev[index]] = next[index];
+	}
+	else {
+		heads[bucketOf(cells[index])] = next[index];
+	}
+	if (next[index] >= 0) {
+		prev[next[index]] = prev[index];
+	}
+}
+
+int SpatialHash::add(Sphere* sphere) {
+	int index = (int)spheres.size();
+	spheres.push_back(sphere);
+	next.push_back(-1);
+	prev.push_back(-1);
+	cells.push_back(0);
+	link(index, cellOf(sphere->getPosition()));
+	maxRadius = cMax(maxRadius, sphere->getRadius());
+	candidates.reserve(spheres.size());
+	return index;
+}
+
+void SpatialHash::update() {
+	for (int i = 0; i < (int)spheres.size(); i++) {
+		update(i);
+	}
+}
+
+void SpatialHash::update(int index) {
+	long long cell = cellOf(spheres[index]->getPosition());
+	if (cell != cells[index]) {
+		unlink(index);
+		link(index, cell);
+	}
+}
+
+int SpatialHash::query(cVector3d p, double r, vector<int>& out) const {
+	// Any sphere touching the ball has its center within r + maxRadius
+	double reach = r + maxRadius;
+	long long x0 = (long long)floor((p.x() - reach) / cellSize);
+	long long x1 = (long long)floor((p.x() + reach) / cellSize);
+	long long y0 = (long long)floor((p.y() - reach) / cellSize);
+	long long y1 = (long long)floor((p.y() + reach) / cellSize);
+	long long z0 = (long long)floor((p.z() - reach) / cellSize);
+	long long z1 = (long long)floor((p.z() + reach) / cellSize);
+
+	int found = 0;
+	for (long long x = x0; x <= x1; x++) {
+		for (long long y = y0; y <= y1; y++) {
+			for (long long z = z0; z <= z1; z++) {
+				long long cell = packCell(x, y, z);
+				for (int i = heads[bucketOf(cell)]; i >= 0; i = next[i]) {
+					// Buckets are shared by distinct cells
+					if (cells[i] != cell) {
+						continue;
+					}
+					double d = r + spheres[i]->getRadius();
+					if ((spheres[i]->getPosition() - p).lengthsq() < d * d) {
+						out.push_back(i);
+						found++;
+					}
+				}
+			}
+		}
+	}
+	return found;
+}
+
+int SpatialHash::findPairs(vector<pair<int, int>>& out) const {
+	int found = 0;
+	for (int i = 0; i < (int)spheres.size(); i++) {
+		candidates.clear();
+		query(spheres[i]->getPosition(), spheres[i]->getRadius(), candidates);
+		for (int j : candidates) {
+			if (j > i) {
+				out.push_back(make_pair(i, j));
+				found++;
+			}
+		}
+	}
+	return found;
+}
+
+cVector3d SpatialHash::calculateCursorForces(cVector3d c_p, double c_r) {
+	cVector3d force(0, 0, 0);
+	candidates.clear();
+	query(c_p, c_r, candidates);
+	for (int i : candidates) {
+		force += spheres[i]->calculateForces(c_p, c_r);
+	}
+	return force;
+}
+
+void SpatialHash::calculateContactForces() {
+	for (int i = 0; i < (int)spheres.size(); i++) {
+		candidates.clear();
+		query(spheres[i]->getPosition(), spheres[i]->getRadius(), candidates);
+		for (int j : candidates) {
+			if (j > i) {
+				spheres[i]->calculateContact(spheres[j]);
+			}
+		}
+	}
+}
+
+Sphere* SpatialHash::getSphere(int index) {
+	return spheres[index];
+}
+
+int SpatialHash::getNumSpheres() {
+	return (int)spheres.size();
+}
@@ -0,0 +1,64 @@
+#ifndef spatial_hash_h
+#define spatial_hash_h
+
+#include <stdio.h>
+#include "chai3d.h"
+#include "sphere.h"
+#include <vector>
+
+using namespace chai3d;
+using namespace std;
+
+// Uniform spatial hash over sphere positions. Each sphere is binned by the
+// grid cell of its center; on update only the spheres that crossed into a new
+// cell are moved, so a step costs O(N) reads and O(moved) list edits. The cell
+// size should be at least the largest sphere diameter.
+class SpatialHash {
+	double cellSize;
+	int tableMask;
+	// largest radius of any sphere, widens the cells visited by a query
+	double maxRadius = 0.0;
+
+	vector<Sphere*> spheres;
+	// head of the sphere list of each bucket
+	vector<int> heads;
+	vector<int> next;
+	vector<int> prev;
+	// packed grid cell each sphere is binned in
+	vector<long long> cells;
+
+	// scratch list reused by the queries so they never allocate
+	mutable vector<int> candidates;
+
+	long long cellOf(const cVector3d& p) const;
+	int bucketOf(long long cell) const;
+	void link(int index, long long cell);
+	void unlink(int index);
+
+public:
+
+	SpatialHash(double cellSize, int tableSize = 4096);
+
+	// Adds a sphere and returns its index
+	int add(Sphere*);
+	// Re-bins the spheres that moved to another cell
+	void update();
+	// Re-bins one sphere if it moved to another cell
+	void update(int index);
+
+	// Appends the indices of the spheres penetrating the ball (p, r)
+	int query(cVector3d p, double r, vector<int>& out) const;
+	// Appends every pair of penetrating spheres once, with i < j
+	int findPairs(vector<pair<int, int>>& out) const;
+
+	// Applies cursor contact to the spheres it touches, returns the force on the cursor
+	cVector3d calculateCursorForces(cVector3d c_p, double c_r);
+	// Applies contact forces between all penetrating spheres
+	void calculateContactForces();
+
+	Sphere* getSphere(int);
+	int getNumSpheres();
+
+};
+
+#endif
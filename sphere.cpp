@@ -39,6 +39,19 @@ cVector3d Sphere::calculateForces(cVector3d c_p, double c_r) {
 	return -force;
 }
 
+void Sphere::calculateContact(Sphere* other) {
+	cVector3d dist = other->getPosition() - getPosition();
+	double length = dist.length();
+	double d = (radius + other->radius) - length;
+
+	if (d > 0 && length > 0) {
+		dist.normalize();
+		cVector3d force = dist * d * k;
+		other->addForce(force);
+		addForce(-force);
+	}
+}
+
 void Sphere::addForce(cVector3d force) {
 	if (!fixed) {
 		global_forces.push_back(force);
@@ -48,3 +61,7 @@ void Sphere::addForce(cVector3d force) {
 cVector3d Sphere::getPosition() {
 	return point->getLocalPos();
 }
+
+double Sphere::getRadius() {
+	return radius;
+}
@@ -29,10 +29,13 @@ public:
 	// Given the cursor position will calculate the forces to be applied to the sphere
 	// Will return force applied back to the cursor
 	cVector3d calculateForces(cVector3d c_p, double c_r);
+	// Given another sphere will apply equal and opposite penetration forces to both
+	void calculateContact(Sphere* other);
 
 	void addForce(cVector3d);
 
 	cVector3d getPosition();
+	double getRadius();
 
 };
 
@@ -25,3 +25,10 @@ void Spring::updateSpring() {
 	line->m_pointB = p_b->getPosition();
 }
 
+Sphere* Spring::getSphereA() {
+	return p_a;
+}
+
+Sphere* Spring::getSphereB() {
+	return p_b;
+}
@@ -19,5 +19,8 @@ public:
 	void calculateForces();
 	void updateSpring();
 
+	Sphere* getSphereA();
+	Sphere* getSphereB();
+
 };
 #endif
@@ -0,0 +1,133 @@
+#include "timer_wheel.h"
+
+TimerWheel::TimerWheel(double tickResolution, int capacity) {
+	resolution = tickResolution;
+	timers.resize(capacity);
+	reset(0.0);
+}
+
+void TimerWheel::reset(double time) {
+	now = (long long)(time / resolution);
+	for (int i = 0; i < LEVELS * SLOTS; i++) {
+		heads[i] = -1;
+	}
+	// Chain every timer into the free list
+	for (int i = 0; i < (int)timers.size(); i++) {
+		timers[i].slot = -1;
+		timers[i].next = i + 1 < (int)timers.size() ? i + 1 : -1;
+	}
+	freeList = timers.empty() ? -1 : 0;
+}
+
+int TimerWheel::schedule(double time, int id) {
+	if (freeList < 0) {
+		return -1;
+	}
+	int handle = freeList;
+	freeList = timers[handle].next;
+
+	long long expiry = (long long)(time / resolution);
+	// Events in the past fire on the next tick
+	if (expiry <= now) {
+		expiry = now + 1;
+	}
+	timers[handle].expiry = expiry;
+	timers[handle].id = id;
+	insert(handle);
+	return handle;
+}
+
+void TimerWheel::cancel(int handle) {
+	if (handle < 0 || handle >= (int)timers.size() || timers[handle].slot < 0) {
+		return;
+	}
+	unlink(handle);
+	timers[handle].next = freeList;
+	freeList = handle;
+}
+
+int TimerWheel::advance(double time, vector<int>& due) {
+	long long target = (long long)(time / resolution);
+	int fired = 0;
+
+	while (now < target) {
+		now++;
+		// When a level wraps around, redistribute the next slot of the level above
+		for (int level = 0; level < LEVELS - 1; level++) {
+			if ((now >> (level * SLOT_BITS)) & (SLOTS - 1)) {
+				break;
+			}
+			cascade(level + 1);
+		}
+
+		int slot = (int)(now & (SLOTS - 1));
+		while (heads[slot] >= 0) {
+			int handle = heads[slot];
+			unlink(handle);
+			timers[handle].next = freeList;
+			freeList = handle;
+			due.push_back(timers[handle].id);
+			fired++;
+		}
+	}
+	return fired;
+}
+
+int TimerWheel::getNumPending() const {
+	int pending = 0;
+	for (const Timer& t : timers) {
+		if (t.slot >= 0) {
+			pending++;
+		}
+	}
+	return pending;
+}
+
+void TimerWheel::insert(int handle) {
+	Timer& t = timers[handle];
+	long long delta = t.expiry - now;
+
+	// Pick the finest level whose span still covers the delay
+	int level = 0;
+	while (level < LEVELS - 1 && delta >= (1LL << ((level + 1) * SLOT_BITS))) {
+		level++;
+	}
+	long long expiry = t.expiry;
+	// Events beyond the last level wait in its furthest slot and cascade down later
+	if (delta >= (1LL << (LEVELS * SLOT_BITS))) {
+		expiry = now + (1LL << (LEVELS * SLOT_BITS)) - 1;
+	}
+
+	t.slot = level * SLOTS + (int)((expiry >> (level * SLOT_BITS)) & (SLOTS - 1));
+	t.prev = -1;
+	t.next = heads[t.slot];
+	if (t.next >= 0) {
+		timers[t.next].prev = handle;
+	}
+	heads[t.slot] = handle;
+}
+
+void TimerWheel::unlink(int handle) {
+	Timer& t = timers[handle];
+	if (t.prev >= 0) {
+		timers[t.prev].next = t.next;
+	}
+	else {
+		heads[t.slot] = t.next;
+	}
+	if (t.next >= 0) {
+		timers[t.next].prev = t.prev;
+	}
+	t.slot = -1;
+}
+
+void TimerWheel::cascade(int level) {
+	int slot = level * SLOTS + (int)((now >> (level * SLOT_BITS)) & (SLOTS - 1));
+	int handle = heads[slot];
+	heads[slot] = -1;
+	while (handle >= 0) {
+		int next = timers[handle].next;
+		insert(handle);
+		handle = next;
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef timer_wheel_h
+#define timer_wheel_h
+
+#include <stdio.h>
+#include <vector>
+
+using namespace std;
+
+// Hierarchical timer wheel. Events are bucketed by due time into a few levels
+// of slots, so advancing the clock only touches the slots that come due and
+// the cost per tick scales with the number of events, not with what is waiting.
+class TimerWheel {
+	static const int SLOT_BITS = 6;
+	static const int SLOTS = 1 << SLOT_BITS;
+	static const int LEVELS = 4;
+
+	struct Timer {
+		long long expiry;
+		int id;
+		int prev;
+		int next;
+		int slot;
+	};
+
+	// resolution of one wheel tick [s]
+	double resolution;
+	// current wheel tick
+	long long now;
+	// preallocated timers, unused ones are chained in a free list
+	vector<Timer> timers;
+	int freeList;
+	// head of the timer list of each slot of each level
+	int heads[LEVELS * SLOTS];
+
+	void insert(int handle);
+	void unlink(int handle);
+	void cascade(int level);
+
+public:
+
+	TimerWheel(double tickResolution = 0.001, int capacity = 64);
+
+	// Schedules an event id to fire at the given time, returns a handle or -1 when full
+	int schedule(double time, int id);
+	// Removes a pending event, ignores invalid handles
+	void cancel(int handle);
+	// Moves the wheel forward to the given time and appends the ids of the due events
+	int advance(double time, vector<int>& due);
+	// Clears all pending events and restarts the wheel at the given time
+	void reset(double time = 0.0);
+
+	int getNumPending() const;
+
+};
+
+#endif
@@ -0,0 +1,221 @@
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+static const char* TRACE_NAMES[TRACE_EVENTS] = {
+	"haptic tick", "frame", "swap", "hit", "sound", "vibration", "hud", "photon"
+};
+
+// ring of the calling thread, set when it registers
+static thread_local TraceRing* threadRing = NULL;
+
+TraceRing::TraceRing(const string& n, uint8_t t, size_t capacity) : head(0), tail(0), dropped(0), name(n), thread(t) {
+	size_t size = 1;
+	while (size < capacity) {
+		size <<= 1;
+	}
+	records.resize(size);
+	mask = size - 1;
+}
+
+void TraceRing::push(const TraceRecord& record) {
+	uint64_t h = head.load(memory_order_relaxed);
+	if (h - tail.load(memory_order_acquire) > mask) {
+		dropped.fetch_add(1, memory_order_relaxed);
+		return;
+	}
+	records[h & mask] = record;
+	head.store(h + 1, memory_order_release);
+}
+
+void TraceRing::drain(vector<TraceRecord>& out) {
+	uint64_t t = tail.load(memory_order_relaxed);
+	uint64_t h = head.load(memory_order_acquire);
+	for (; t < h; t++) {
+		out.push_back(records[t & mask]);
+	}
+	tail.store(t, memory_order_release);
+}
+
+long long TraceRing::getDropped() const {
+	return dropped.load(memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+
+Tracer::Tracer(size_t capacity, size_t records) : enabled(false), numThreads(0) {
+	ringCapacity = capacity;
+	maxRecords = records;
+	origin = now();
+}
+
+void Tracer::setEnabled(bool e) {
+	enabled.store(e, memory_order_relaxed);
+}
+
+bool Tracer::isEnabled() const {
+	return enabled.load(memory_order_relaxed);
+}
+
+void Tracer::registerThread(const string& name) {
+	if (!isEnabled() || threadRing != NULL) {
+		return;
+	}
+	// the haptic and graphics threads may register at the same time, the lock
+	// gives each its own slot and the count only publishes a complete ring
+	lock_guard<mutex> guard(registerLock);
+	int thread = numThreads.load(memory_order_relaxed);
+	if (thread >= MAX_THREADS) {
+		return;
+	}
+	rings[thread].reset(new TraceRing(name, (uint8_t)thread, ringCapacity));
+	threadRing = rings[thread].get();
+	numThreads.store(thread + 1, memory_order_release);
+}
+
+long long Tracer::now() const {
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TraceRing* Tracer::currentRing() const {
+	return threadRing;
+}
+
+void Tracer::record(TraceEvent event, TracePhase phase, uint32_t arg) {
+	if (!isEnabled()) {
+		return;
+	}
+	record(event, phase, arg, now());
+}
+
+void Tracer::record(TraceEvent event, TracePhase phase, uint32_t arg, long long time) {
+	TraceRing* ring = currentRing();
+	if (!isEnabled() || ring == NULL) {
+		return;
+	}
+	TraceRecord r;
+	r.time = time;
+	r.arg = arg;
+	r.event = (uint16_t)event;
+	r.phase = (uint8_t)phase;
+	r.thread = ring->thread;
+	ring->push(r);
+}
+
+void Tracer::collect() {
+	lock_guard<mutex> guard(sessionLock);
+	int threads = numThreads.load(memory_order_acquire);
+	for (int t = 0; t < threads; t++) {
+		size_t start = session.size();
+		rings[t]->drain(session);
+		// past the size of a session only the latest drain is forgotten
+		if (session.size() > maxRecords) {
+			sessionDropped += (long long)(session.size() - (start > maxRecords ? start : maxRecords));
+			session.resize(start > maxRecords ? start : maxRecords);
+		}
+	}
+}
+
+void Tracer::printLatencies(ostream& out) {
+	collect();
+	lock_guard<mutex> guard(sessionLock);
+
+	// hits in time order, and each kind of feedback in time order
+	const TraceEvent feedbacks[4] = { TRACE_SOUND, TRACE_VIBRATION, TRACE_HUD, TRACE_PHOTON };
+	vector<TraceRecord> hits;
+	vector<TraceRecord> feedback[4];
+	for (const TraceRecord& r : session) {
+		if (r.phase != TRACE_INSTANT) {
+			continue;
+		}
+		if (r.event == TRACE_HIT) {
+			hits.push_back(r);
+		}
+		for (int k = 0; k < 4; k++) {
+			if (r.event == feedbacks[k]) {
+				feedback[k].push_back(r);
+			}
+		}
+	}
+	auto byTime = [](const TraceRecord& a, const TraceRecord& b) { return a.time < b.time; };
+	sort(hits.begin(), hits.end(), byTime);
+
+	long long dropped = sessionDropped;
+	for (int t = 0; t < numThreads.load(memory_order_acquire); t++) {
+		dropped += rings[t]->getDropped();
+	}
+	out << "trace: " << session.size() << " events, " << dropped << " dropped, " << hits.size() << " hits" << endl;
+
+	for (int k = 0; k < 4; k++) {
+		sort(feedback[k].begin(), feedback[k].end(), byTime);
+
+		// a frame or a score update shows every hit up to its sequence number,
+		// while a sound or a vibration belongs to its own hit only
+		bool shows = feedbacks[k] == TRACE_HUD || feedbacks[k] == TRACE_PHOTON;
+		vector<double> latencies;
+		size_t first = 0;
+		for (const TraceRecord& hit : hits) {
+			while (first < feedback[k].size() && feedback[k][first].time < hit.time) {
+				first++;
+			}
+			for (size_t i = first; i < feedback[k].size(); i++) {
+				if (shows ? feedback[k][i].arg >= hit.arg : feedback[k][i].arg == hit.arg) {
+					latencies.push_back(1e-6 * (feedback[k][i].time - hit.time));
+					break;
+				}
+			}
+		}
+
+		out << "trace: hit to " << TRACE_NAMES[feedbacks[k]] << " ";
+		if (latencies.empty()) {
+			out << "- no samples" << endl;
+			continue;
+		}
+		sort(latencies.begin(), latencies.end());
+		size_t n = latencies.size();
+		out << "- " << n << " samples, p50 " << latencies[n / 2] << " ms, p90 " << latencies[n * 9 / 10]
+			<< " ms, p99 " << latencies[n * 99 / 100] << " ms, max " << latencies[n - 1] << " ms" << endl;
+	}
+}
+
+bool Tracer::exportChrome(const string& path) {
+	collect();
+	lock_guard<mutex> guard(sessionLock);
+
+	ofstream file(path.c_str());
+	if (!file) {
+		return false;
+	}
+
+	vector<TraceRecord> records = session;
+	stable_sort(records.begin(), records.end(), [](const TraceRecord& a, const TraceRecord& b) { return a.time < b.time; });
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << endl;
+	bool firstEvent = true;
+	int threads = numThreads.load(memory_order_acquire);
+	for (int t = 0; t < threads; t++) {
+		file << (firstEvent ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t
+			<< ",\"args\":{\"name\":\"" << rings[t]->name << "\"}}";
+		firstEvent = false;
+	}
+
+	static const char PHASES[3] = { 'B', 'E', 'i' };
+	char ts[32];
+	for (const TraceRecord& r : records) {
+		// microseconds from the start of the session
+		snprintf(ts, sizeof(ts), "%.3f", 1e-3 * (r.time - origin));
+		file << (firstEvent ? "" : ",\n") << "{\"name\":\"" << TRACE_NAMES[r.event] << "\",\"ph\":\"" << PHASES[r.phase]
+			<< "\",\"ts\":" << ts << ",\"pid\":1,\"tid\":" << (int)r.thread;
+		if (r.phase == TRACE_INSTANT) {
+			file << ",\"s\":\"t\"";
+		}
+		if (r.arg != 0) {
+			file << ",\"args\":{\"hit\":" << r.arg << "}";
+		}
+		file << "}";
+		firstEvent = false;
+	}
+	file << endl << "]}" << endl;
+	return file.good();
+}
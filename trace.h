@@ -0,0 +1,120 @@
+#ifndef trace_h
+#define trace_h
+
+#include <stdio.h>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Trace points of the game. Spans have a begin and an end, the others are
+// instants. Hit feedback events carry the sequence number of their hit.
+enum TraceEvent {
+	TRACE_HAPTIC_TICK,
+	TRACE_FRAME,
+	TRACE_SWAP,
+	TRACE_HIT,
+	TRACE_SOUND,
+	TRACE_VIBRATION,
+	TRACE_HUD,
+	TRACE_PHOTON,
+	TRACE_EVENTS
+};
+
+enum TracePhase {
+	TRACE_BEGIN,
+	TRACE_END,
+	TRACE_INSTANT
+};
+
+struct TraceRecord {
+	// nanoseconds on the shared monotonic clock
+	long long time;
+	uint32_t arg;
+	uint16_t event;
+	uint8_t phase;
+	uint8_t thread;
+};
+
+// Records of one thread. Only that thread writes and only the collector
+// reads, so neither ever waits. A full ring drops new records.
+class TraceRing {
+	vector<TraceRecord> records;
+	uint64_t mask;
+	atomic<uint64_t> head;
+	atomic<uint64_t> tail;
+	atomic<long long> dropped;
+
+public:
+
+	string name;
+	uint8_t thread;
+
+	// capacity is rounded up to a power of two
+	TraceRing(const string& name, uint8_t thread, size_t capacity);
+
+	void push(const TraceRecord& record);
+	// Moves every record written so far to the end of out
+	void drain(vector<TraceRecord>& out);
+	long long getDropped() const;
+};
+
+// Collects trace points of the haptic, graphics and audio paths into one
+// session, measures the latency from a hit to each of its feedbacks and
+// exports the session as Chrome trace events (chrome://tracing, Perfetto).
+// Every thread that records registers once, before its loop starts.
+class Tracer {
+	static const int MAX_THREADS = 8;
+
+	atomic<bool> enabled;
+	size_t ringCapacity;
+	size_t maxRecords;
+	long long origin;
+
+	unique_ptr<TraceRing> rings[MAX_THREADS];
+	atomic<int> numThreads;
+	mutex registerLock;
+
+	mutex sessionLock;
+	vector<TraceRecord> session;
+	long long sessionDropped = 0;
+
+	TraceRing* currentRing() const;
+
+public:
+
+	// rings of ringCapacity records, a session of at most maxRecords
+	Tracer(size_t ringCapacity = 1 << 16, size_t maxRecords = 1 << 22);
+
+	void setEnabled(bool enabled);
+	bool isEnabled() const;
+
+	// Gives the calling thread its own ring
+	void registerThread(const string& name);
+
+	// Nanoseconds on the monotonic clock shared by all threads
+	long long now() const;
+
+	// Records an event of the calling thread now, or at a given time
+	void record(TraceEvent event, TracePhase phase, uint32_t arg = 0);
+	void record(TraceEvent event, TracePhase phase, uint32_t arg, long long time);
+	void begin(TraceEvent event, uint32_t arg = 0) { record(event, TRACE_BEGIN, arg); }
+	void end(TraceEvent event, uint32_t arg = 0) { record(event, TRACE_END, arg); }
+	void instant(TraceEvent event, uint32_t arg = 0) { record(event, TRACE_INSTANT, arg); }
+
+	// Drains the rings of all threads into the session
+	void collect();
+
+	// Logs the distributions of the latency from a hit to its sound, its
+	// vibration, the score update and the first frame showing it
+	void printLatencies(ostream& out);
+	// Writes the session as Chrome trace event JSON
+	bool exportChrome(const string& path);
+};
+
+#endif